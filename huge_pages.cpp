@@ -0,0 +1,57 @@
+#include "huge_pages.h"
+
+#include <new>
+#include <sys/mman.h>
+
+namespace {
+
+bool enabled = true;
+
+size_t round_up(size_t bytes) {
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+bool use_huge_pages(size_t bytes) {
+    return enabled && bytes >= HUGE_PAGE_SIZE;
+}
+
+}  // namespace
+
+void disable_huge_pages() {
+    enabled = false;
+}
+
+void* huge_page_alloc(size_t bytes) {
+    if (!use_huge_pages(bytes)) {
+        return ::operator new(bytes);
+    }
+    size_t size = round_up(bytes);
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        return p;
+    }
+
+    // No reserved huge pages: map one page extra, trim it to a 2 MB boundary
+    // and ask for transparent huge pages.
+    char* raw = static_cast<char*>(mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    size_t head = (HUGE_PAGE_SIZE - (size_t)raw % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+    if (head > 0) {
+        munmap(raw, head);
+    }
+    munmap(raw + head + size, HUGE_PAGE_SIZE - head);
+    madvise(raw + head, size, MADV_HUGEPAGE);
+    return raw + head;
+}
+
+void huge_page_free(void* p, size_t bytes) {
+    if (!use_huge_pages(bytes)) {
+        ::operator delete(p);
+        return;
+    }
+    munmap(p, round_up(bytes));
+}
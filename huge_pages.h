@@ -0,0 +1,43 @@
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <cstddef>
+#include <vector>
+
+// Backing for the engine's large flat arrays with 2 MB pages, so random
+// access across tens of MB of team records and index nodes stays within a
+// few TLB entries. A block of at least one huge page is mapped with
+// MAP_HUGETLB when the system has reserved huge pages, and otherwise as a
+// 2 MB-aligned anonymous mapping advised with MADV_HUGEPAGE (transparent
+// huge pages). Smaller blocks, and every block once disabled, come from
+// operator new.
+
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// Must be called before the first allocation, if at all.
+void disable_huge_pages();
+
+void* huge_page_alloc(size_t bytes);
+void huge_page_free(void* p, size_t bytes);
+
+template <class T>
+struct HugePageAllocator {
+    typedef T value_type;
+
+    HugePageAllocator() {}
+    template <class U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(huge_page_alloc(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { huge_page_free(p, n * sizeof(T)); }
+};
+
+template <class T, class U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return false; }
+
+template <class T>
+using HugeVector = std::vector<T, HugePageAllocator<T>>;
+
+#endif
@@ -1,19 +1,36 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <functional>
+#include <thread>
+#include <system_error>
 #include <algorithm>
+#include <numeric>
 #include <sstream>
+#include <fstream>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cerrno>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "huge_pages.h"
+#include "memory_stats.h"
+#include "name_table.h"
+#include "perf_counters.h"
+#include "ranking_index.h"
+#include "rating.h"
+#include "scoreboard_server.h"
+#include "submission_log.h"
+#include "submission_store.h"
 
 using namespace std;
 
-struct Submission {
-    string problem;
-    string status;
-    int time;
-    bool before_freeze;
-};
-
 struct ProblemStatus {
     bool solved;
     int solve_time;
@@ -26,36 +43,337 @@ struct ProblemStatus {
                       wrong_attempts_before_freeze(0), submissions_after_freeze(0), frozen(false) {}
 };
 
+// What the ranking index orders a team by, as of the last flush: the hot
+// part of a team's key, packed so a comparison reads one record per team.
+// The solve times that break the rare full ties stay in Team::key_solve_times.
+struct RankKey {
+    int solved;
+    int penalty;
+    long long name_ordinal; // label increasing with the name, see assign_name_ordinal
+
+    RankKey() : solved(0), penalty(0), name_ordinal(0) {}
+};
+
+// Whether a team takes a place in the ranking. HIDDEN teams are still
+// listed on the board, without a rank; DISQUALIFIED teams are not listed.
+enum Listing { RANKED, HIDDEN, DISQUALIFIED };
+
 struct Team {
     string name;
-    map<string, ProblemStatus> problems;
-    vector<Submission> submissions;
+    int id; // position in team_order
     int solved_count;
     int penalty_time;
+    int penalty_offset; // jury adjustment in minutes, included in penalty_time
     int ranking;
     vector<int> solve_times; // for tie-breaking
+    int published_rank;      // row last sent to the HTTP server, for deltas
+    string published_stats;  // solved, penalty and cells of that row
+    bool published_row;      // whether that board had a row for the team
+    // Change history by flush version, for QUERY_DIFF. Cell states are
+    // numbered: a change takes a fresh number, an undo restores the old one,
+    // so equal numbers mean equal cells.
+    int cells;
+    int flushed_cells;
+    int flushed_rank;
+    int last_modified;       // last version that changed the rank or cells
+    vector<pair<int, int>> rank_history; // (version, rank) at every rank change
+    vector<pair<int, int>> cell_history; // (version, cells) at every cells change
+    vector<int> key_solve_times; // solve times of the key, largest first
+    bool key_stale;          // key may be out of date; re-keyed at the next flush
+    Listing listing;         // applied to the ranking index at the next flush
+
+    Team() : id(0), solved_count(0), penalty_time(0), penalty_offset(0),
+             ranking(0), published_rank(0), published_row(false), cells(0), flushed_cells(0), flushed_rank(0), last_modified(0),
+             key_stale(false), listing(RANKED) {}
+};
+
+// "Team a ranks above team b" by the keys stored at the last flush.
+struct RankKeyLess {
+    const HugeVector<RankKey>* keys;
+    const vector<Team*>* teams;
+
+    bool operator()(int a, int b) const {
+        const RankKey& k1 = (*keys)[a];
+        const RankKey& k2 = (*keys)[b];
+        if (k1.solved != k2.solved) {
+            return k1.solved > k2.solved;
+        }
+        if (k1.penalty != k2.penalty) {
+            return k1.penalty < k2.penalty;
+        }
+        // Equal solved counts, so both time lists have the same length
+        const vector<int>& times1 = (*teams)[a]->key_solve_times;
+        const vector<int>& times2 = (*teams)[b]->key_solve_times;
+        for (size_t i = 0; i < times1.size(); i++) {
+            if (times1[i] != times2[i]) {
+                return times1[i] < times2[i];
+            }
+        }
+        return k1.name_ordinal < k2.name_ordinal;
+    }
+};
+
+// Earliest accepted submission of a problem known to the scoreboard.
+struct FirstSolve {
+    int team; // -1 while unsolved
+    int time;
+    int submission; // breaks ties between equal times by arrival
+
+    FirstSolve() : team(-1), time(0), submission(0) {}
+};
+
+// Inverse of one mutating command, for UNDO. Records are undone newest
+// first, so a SUBMIT is always the last entry of every list it was added to.
+enum UndoKind { UNDO_ADD_TEAM, UNDO_SUBMIT, UNDO_FREEZE, UNDO_PENALTY, UNDO_LISTING };
+
+struct UndoRecord {
+    UndoKind kind;
+    int team;
+    int value; // PENALTY: minutes; LISTING: the previous listing;
+               // FREEZE: the previous freeze_begin; SUBMIT: the problem
+
+    UndoRecord() : kind(UNDO_SUBMIT), team(0), value(0) {}
+};
+
+// What a SUBMIT overwrote, kept apart so the other records stay small.
+struct SubmitUndo {
+    ProblemStatus status; // the problem before it
+    FirstSolve first;     // the problem's first solve before it
+    int cells;            // the team's cell state before it
+
+    SubmitUndo() : cells(0) {}
+};
+
+// The newest records up to a fixed capacity; a push past it overwrites the
+// oldest. The storage is allocated once, by the first push.
+template <class T>
+class UndoRing {
+public:
+    explicit UndoRing(size_t capacity) : capacity(capacity), head(0), count(0) {}
+
+    bool empty() const { return count == 0; }
+    bool full() const { return count == capacity; }
+    size_t size() const { return count; }
+
+    void push_back(const T& value) {
+        if (items.empty()) items.resize(capacity);
+        if (full()) {
+            items[head] = value;
+            head = (head + 1) % capacity;
+        } else {
+            items[(head + count++) % capacity] = value;
+        }
+    }
+
+    T& front() { return items[head]; }
+    T& back() { return items[(head + count - 1) % capacity]; }
+
+    void pop_front() {
+        head = (head + 1) % capacity;
+        count--;
+    }
+
+    void pop_back() { count--; }
+
+    void clear() { head = count = 0; }
 
-    Team() : solved_count(0), penalty_time(0), ranking(0) {}
+    MemoryUsage memory() const {
+        return MemoryUsage(count * sizeof(T), items.capacity() * sizeof(T));
+    }
+
+private:
+    vector<T> items;
+    size_t capacity;
+    size_t head; // oldest record
+    size_t count;
+};
+
+// "Team a ranks above team b" by the teams' current stats, as the scroll and
+// the printed boards order them: more solved problems, less penalty, smaller
+// solve times from the largest down, then the name.
+struct StatsLess {
+    const vector<Team*>* teams;
+
+    bool operator()(int a, int b) const {
+        const Team& t1 = *(*teams)[a];
+        const Team& t2 = *(*teams)[b];
+        if (t1.solved_count != t2.solved_count) {
+            return t1.solved_count > t2.solved_count;
+        }
+        if (t1.penalty_time != t2.penalty_time) {
+            return t1.penalty_time < t2.penalty_time;
+        }
+        for (size_t i = 0; i < min(t1.solve_times.size(), t2.solve_times.size()); i++) {
+            if (t1.solve_times[i] != t2.solve_times[i]) {
+                return t1.solve_times[i] < t2.solve_times[i];
+            }
+        }
+        return t1.name < t2.name;
+    }
+};
+
+// What revealing one frozen problem of a team does, worked out before the
+// scroll so that the reveal loop only has to order teams and print.
+struct FrozenOutcome {
+    int team;
+    int problem;
+    bool solved;
+    int solve_time;
+    int submission;     // arrival index of the solving submission
+    int wrong_attempts; // frozen rejections before it, or all of them
+    int penalty;        // added to the team's penalty if solved
+
+    FrozenOutcome(int team, int problem)
+        : team(team), problem(problem), solved(false), solve_time(0), submission(0),
+          wrong_attempts(0), penalty(0) {}
+};
+
+// Scratch space of SCROLL and of the printed boards. Sized with the team set
+// and only ever cleared, so once it has grown a scroll allocates nothing
+// beyond the threads of the outcome pre-pass.
+struct ScrollWorkspace {
+    RankingIndex<StatsLess> standing; // ranked teams during a scroll
+    vector<int> frozen_left; // team id -> problems still frozen
+    vector<FrozenOutcome> outcomes; // every frozen problem, by team then problem
+    vector<int> next_outcome;       // team id -> its next outcome to reveal
+    vector<int> board;       // team ids of a printed board, best first
+    string events;           // rank changes of the reveal loop, printed once
+
+    explicit ScrollWorkspace(const vector<Team*>* teams) : standing(StatsLess{teams}) {}
+
+    MemoryUsage memory() const {
+        MemoryUsage usage = standing.memory();
+        usage += vector_usage(frozen_left);
+        usage += vector_usage(outcomes);
+        usage += vector_usage(next_outcome);
+        usage += vector_usage(board);
+        usage += string_usage(events);
+        return usage;
+    }
 };
 
 class ICPCSystem {
 private:
     map<string, Team> teams;
     vector<string> team_order; // for maintaining order
+    vector<Team*> team_by_id;  // map nodes never move, so these stay valid
+    vector<int> name_index;    // team ids in lexicographic name order, built at START
+    map<string, int> late_names; // teams registered after START, by name
+    bool late_registration;
+    // The team map is the registration builder. START seals the team set into
+    // flat layouts indexed by team id; late teams are appended to them.
+    NameTable sealed_names;               // START teams; late ones are in late_names
+    HugeVector<RankKey> rank_keys;            // what the ranking index compares
+    HugeVector<ProblemStatus> problem_states; // problem_count entries per team
     bool competition_started;
     bool is_frozen;
     int duration_time;
     int problem_count;
     vector<string> problem_names;
     int freeze_time;
+    int flush_version; // bumped on every flush, used as the HTTP ETag
+    int cells_issued;  // last cell state number handed out
+    ScoreboardServer* server;
+    shared_ptr<const ScoreboardSnapshot> published; // last board handed to the server
+    shared_ptr<const unordered_map<string, int>> team_ids; // shared with every snapshot
+    SubmissionStore submissions;    // every submission in arrival order
+    size_t freeze_begin;            // first submission of the current freeze
+    string export_path;             // columnar submission log written at END
+    RankingIndex<RankKeyLess> ranking_index; // flushed order of all teams
+    vector<int> stale_teams;                 // ids with key_stale set
+    vector<int> solved_histogram;            // flushed team count per solved count
+    vector<FirstSolve> first_solves;         // per problem
+    string awards_path;                      // award report written at END
+    unordered_map<string, string> team_groups;
+    string ratings_in, ratings_out;          // rating update written at END
+    UndoRing<UndoRecord> journal;            // newest last, at most MAX_UNDO
+    UndoRing<SubmitUndo> submit_undos;       // one per SUBMIT record in journal
+    ScrollWorkspace scroll_space;
+    static const size_t MAX_UNDO = 1 << 16;
+
+    void record_undo(const UndoRecord& record) {
+        if (journal.full() && journal.front().kind == UNDO_SUBMIT) {
+            submit_undos.pop_front();
+        }
+        journal.push_back(record);
+    }
+
+    void record_submit(const UndoRecord& record, const SubmitUndo& before) {
+        record_undo(record);
+        submit_undos.push_back(before);
+    }
+
+    void clear_journal() {
+        journal.clear();
+        submit_undos.clear();
+    }
+
+    void record_listing(const Team& team) {
+        UndoRecord record;
+        record.kind = UNDO_LISTING;
+        record.team = team.id;
+        record.value = team.listing;
+        record_undo(record);
+    }
+
+    void undo_one(const UndoRecord& record) {
+        switch (record.kind) {
+        case UNDO_ADD_TEAM:
+            teams.erase(team_order.back());
+            team_order.pop_back();
+            team_by_id.pop_back();
+            break;
+        case UNDO_SUBMIT: {
+            Team& team = *team_by_id[record.team];
+            const SubmitUndo& before = submit_undos.back();
+            first_solves[record.value] = before.first;
+            problem_state(team, record.value) = before.status;
+            submissions.pop_back(team.id);
+            team.cells = before.cells;
+            mark_stale(team);
+            submit_undos.pop_back();
+            break;
+        }
+        case UNDO_FREEZE:
+            is_frozen = false;
+            freeze_begin = record.value;
+            break;
+        case UNDO_PENALTY:
+            team_by_id[record.team]->penalty_offset -= record.value;
+            mark_stale(*team_by_id[record.team]);
+            break;
+        case UNDO_LISTING:
+            team_by_id[record.team]->listing = (Listing)record.value;
+            mark_stale(*team_by_id[record.team]);
+            break;
+        }
+    }
+
+    ProblemStatus& problem_state(const Team& team, int problem) {
+        return problem_states[(size_t)team.id * problem_count + problem];
+    }
+
+    // The sealed table after START, the team map before it.
+    Team* find_team(const string& name) {
+        if (!competition_started) {
+            auto it = teams.find(name);
+            return it == teams.end() ? nullptr : &it->second;
+        }
+        int id = sealed_names.find(name);
+        if (id < 0 && !late_names.empty()) {
+            auto late = late_names.find(name);
+            id = late == late_names.end() ? -1 : late->second;
+        }
+        return id < 0 ? nullptr : team_by_id[id];
+    }
 
     void calculate_team_stats(Team& team, bool include_frozen) {
         team.solved_count = 0;
-        team.penalty_time = 0;
+        team.penalty_time = team.penalty_offset;
         team.solve_times.clear();
 
-        for (auto& p : team.problems) {
-            ProblemStatus& ps = p.second;
+        for (int p = 0; p < problem_count; p++) {
+            ProblemStatus& ps = problem_state(team, p);
             if (ps.solved && (!ps.frozen || include_frozen)) {
                 team.solved_count++;
                 team.penalty_time += ps.solve_time + 20 * ps.wrong_attempts_before_first_success;
@@ -90,113 +408,354 @@ private:
         return name1 < name2;
     }
 
-    void flush_scoreboard() {
-        // Pre-calculate all stats
-        for (auto& tp : teams) {
-            calculate_team_stats(tp.second, false);
+    // Called whenever a solve becomes visible: on submit before the freeze and
+    // when scroll reveals a frozen problem. Frozen solves can be revealed out
+    // of time order, hence the comparison.
+    void record_solve(int problem, int team, int time, int submission) {
+        FirstSolve& first = first_solves[problem];
+        if (first.team < 0 || time < first.time ||
+            (time == first.time && submission < first.submission)) {
+            first.team = team;
+            first.time = time;
+            first.submission = submission;
         }
+    }
+
+    // A submission or reveal changed the team's cells and stats.
+    void mark_dirty(Team& team) {
+        team.cells = ++cells_issued;
+        mark_stale(team);
+    }
 
-        vector<string> sorted_teams = team_order;
-        sort(sorted_teams.begin(), sorted_teams.end(), [this](const string& a, const string& b) {
-            Team& t1 = teams[a];
-            Team& t2 = teams[b];
+    // Only the team's key changed (penalty, listing); its cells did not.
+    void mark_stale(Team& team) {
+        if (!team.key_stale) {
+            team.key_stale = true;
+            stale_teams.push_back(team.id);
+        }
+    }
 
-            if (t1.solved_count != t2.solved_count) {
-                return t1.solved_count > t2.solved_count;
+    // Re-keys only the teams that changed since the last flush, then reads
+    // every ranking off the index in order. Teams no longer listed as RANKED
+    // leave the index here, and the teams below them move up with it.
+    void refresh_ranking_index() {
+        for (int id : stale_teams) {
+            Team& team = *team_by_id[id];
+            RankKey& key = rank_keys[id];
+            if (ranking_index.contains(id)) {
+                ranking_index.erase(id);
+                solved_histogram[key.solved]--;
             }
-            if (t1.penalty_time != t2.penalty_time) {
-                return t1.penalty_time < t2.penalty_time;
+            calculate_team_stats(team, false);
+            key.solved = team.solved_count;
+            key.penalty = team.penalty_time;
+            team.key_solve_times = team.solve_times;
+            if (team.listing == RANKED) {
+                solved_histogram[key.solved]++;
+                ranking_index.insert(id);
+            } else {
+                team.ranking = 0;
             }
+            team.key_stale = false;
+        }
+        stale_teams.clear();
 
-            for (size_t i = 0; i < min(t1.solve_times.size(), t2.solve_times.size()); i++) {
-                if (t1.solve_times[i] != t2.solve_times[i]) {
-                    return t1.solve_times[i] < t2.solve_times[i];
-                }
+        int rank = 0;
+        ranking_index.for_each([this, &rank](int id) { team_by_id[id]->ranking = ++rank; });
+    }
+
+    void flush_scoreboard() {
+        refresh_ranking_index();
+        commit_flush();
+    }
+
+    // Assigns the next flush version to the current rankings and cells and
+    // records what changed since the previous one.
+    void commit_flush() {
+        flush_version++;
+        for (Team* team : team_by_id) {
+            bool moved = team->ranking != team->flushed_rank;
+            bool redrawn = team->cells != team->flushed_cells;
+            if (!moved && !redrawn) continue;
+            if (moved) {
+                team->rank_history.push_back(make_pair(flush_version, team->ranking));
+                team->flushed_rank = team->ranking;
+            }
+            if (redrawn) {
+                team->cell_history.push_back(make_pair(flush_version, team->cells));
+                team->flushed_cells = team->cells;
             }
+            team->last_modified = flush_version;
+        }
+        publish_scoreboard();
+    }
 
-            return a < b;
-        });
+    // 0 for a late team at versions before it was first flushed.
+    int rank_at(const Team& team, int version) {
+        return value_at(team.rank_history, version);
+    }
+
+    int cells_at(const Team& team, int version) {
+        return value_at(team.cell_history, version);
+    }
 
-        for (size_t i = 0; i < sorted_teams.size(); i++) {
-            teams[sorted_teams[i]].ranking = i + 1;
+    // The value of a (version, value) history at version; 0 before the first.
+    static int value_at(const vector<pair<int, int>>& history, int version) {
+        auto it = upper_bound(history.begin(), history.end(), make_pair(version, INT_MAX));
+        return it == history.begin() ? 0 : prev(it)->second;
+    }
+
+    // Name ordinals are order-maintenance labels: START spaces them
+    // NAME_ORDINAL_GAP apart, and a late team takes the midpoint between its
+    // neighbours in the name-ordered team map. Only when a gap is used up are
+    // all teams relabelled; the ranking index stays valid either way since
+    // relabelling keeps the relative order.
+    static const long long NAME_ORDINAL_GAP = 1LL << 32;
+    // Reserved per team at START; the store still grows past it if needed.
+    static const size_t EXPECTED_SUBMISSIONS_PER_TEAM = 32;
+
+    void assign_name_ordinal(map<string, Team>::iterator it) {
+        long long low = it == teams.begin() ? 0 : rank_keys[prev(it)->second.id].name_ordinal;
+        long long high = next(it) == teams.end() ? low + 2 * NAME_ORDINAL_GAP
+                                                 : rank_keys[next(it)->second.id].name_ordinal;
+        if (high - low < 2) {
+            long long label = 0;
+            for (auto& tp : teams) {
+                label += NAME_ORDINAL_GAP;
+                rank_keys[tp.second.id].name_ordinal = label;
+            }
+            return;
         }
+        rank_keys[it->second.id].name_ordinal = low + (high - low) / 2;
     }
 
-    void print_scoreboard() {
-        // Pre-calculate all stats
-        for (auto& tp : teams) {
-            calculate_team_stats(tp.second, false);
+    // Registers a team after START: O(log N) in the team map, the late name
+    // map and the ranking index. Everyone else keeps their flushed rank until
+    // the next flush, so the newcomer is ranked last until then rather than
+    // sharing a place with a flushed team; that flush records its first rank.
+    void add_late_team(const string& team_name) {
+        auto it = teams.emplace(team_name, Team()).first;
+        Team& team = it->second;
+        team.name = team_name;
+        team.id = team_order.size();
+        team_order.push_back(team_name);
+        team_by_id.push_back(&team);
+        late_names[team_name] = team.id;
+        team_ids.reset();
+        rank_keys.resize(team_order.size());
+        problem_states.resize(team_order.size() * problem_count);
+        submissions.add_teams(team_order.size());
+
+        assign_name_ordinal(it);
+        ranking_index.resize(team_order.size());
+        ranking_index.insert(team.id);
+        solved_histogram[0]++;
+        // The index holds every flushed ranked team plus the late ones since
+        team.ranking = ranking_index.size();
+        team.cells = ++cells_issued;
+    }
+
+    // "*" for a team listed without a rank.
+    string rank_label(const Team& team) {
+        return team.ranking > 0 ? to_string(team.ranking) : "*";
+    }
+
+    string problem_cell(Team& team, int problem) {
+        ProblemStatus& ps = problem_state(team, problem);
+        if (ps.frozen) {
+            return (ps.wrong_attempts_before_freeze == 0 ? "" : "-")
+                   + to_string(ps.wrong_attempts_before_freeze) + "/"
+                   + to_string(ps.submissions_after_freeze);
         }
+        if (ps.solved) {
+            int wrong = ps.wrong_attempts_before_first_success;
+            return wrong > 0 ? "+" + to_string(wrong) : "+";
+        }
+        int wrong = ps.wrong_attempts_before_freeze;
+        return wrong == 0 ? "." : "-" + to_string(wrong);
+    }
 
-        vector<string> sorted_teams = team_order;
-        sort(sorted_teams.begin(), sorted_teams.end(), [this](const string& a, const string& b) {
-            Team& t1 = teams[a];
-            Team& t2 = teams[b];
+    string team_json(Team& team, const vector<string>& cells) {
+        string json = "{\"name\":\"" + team.name + "\",\"rank\":"
+                      + (team.ranking > 0 ? to_string(team.ranking) : "null")
+                      + ",\"solved\":" + to_string(team.solved_count)
+                      + ",\"penalty\":" + to_string(team.penalty_time) + ",\"cells\":[";
+        for (size_t i = 0; i < cells.size(); i++) {
+            json += (i ? ",\"" : "\"") + cells[i] + "\"";
+        }
+        return json + "]}";
+    }
+
+    // Renders the flushed board once for the HTTP server, together with the
+    // delta against the previous flush (rows whose cells changed, teams whose
+    // rank moved and teams disqualified since) that is pushed to event-stream
+    // subscribers, and the ids of those teams for per-team subscriptions. Teams are listed by their
+    // flushed ranking, a permutation of 1..N after any flush.
+    void publish_scoreboard() {
+        if (!server) return;
 
-            if (t1.solved_count != t2.solved_count) {
-                return t1.solved_count > t2.solved_count;
+        if (!team_ids) {
+            auto ids = make_shared<unordered_map<string, int>>();
+            for (auto& tp : teams) {
+                (*ids)[tp.first] = tp.second.id;
             }
-            if (t1.penalty_time != t2.penalty_time) {
-                return t1.penalty_time < t2.penalty_time;
+            team_ids = ids;
+        }
+
+        // Ranked teams in order, with hidden teams merged in where their keys
+        // would place them
+        vector<int> hidden;
+        for (Team* team : team_by_id) {
+            if (team->listing == HIDDEN) hidden.push_back(team->id);
+        }
+        RankKeyLess less{&rank_keys, &team_by_id};
+        sort(hidden.begin(), hidden.end(), less);
+        vector<Team*> by_rank;
+        by_rank.reserve(ranking_index.size() + hidden.size());
+        auto h = hidden.begin();
+        ranking_index.for_each([&](int id) {
+            for (; h != hidden.end() && less(*h, id); ++h) {
+                by_rank.push_back(team_by_id[*h]);
             }
+            by_rank.push_back(team_by_id[id]);
+        });
+        for (; h != hidden.end(); ++h) {
+            by_rank.push_back(team_by_id[*h]);
+        }
 
-            for (size_t i = 0; i < min(t1.solve_times.size(), t2.solve_times.size()); i++) {
-                if (t1.solve_times[i] != t2.solve_times[i]) {
-                    return t1.solve_times[i] < t2.solve_times[i];
-                }
+        auto snapshot = make_shared<ScoreboardSnapshot>();
+        snapshot->version = flush_version;
+        snapshot->team_ids = team_ids;
+        snapshot->row_offsets.resize(team_order.size());
+        string& text = snapshot->text;
+        string& json = snapshot->json;
+        string rows, moves, removed;
+
+        // Team names are limited to letters, digits and underscores, so they
+        // need no JSON escaping.
+        json = "{\"version\":" + to_string(flush_version)
+               + ",\"frozen\":" + (is_frozen ? "true" : "false") + ",\"problems\":[";
+        for (size_t i = 0; i < problem_names.size(); i++) {
+            json += (i ? ",\"" : "\"") + problem_names[i] + "\"";
+        }
+        json += "],\"teams\":[";
+
+        vector<string> cells(problem_names.size());
+        for (size_t r = 0; r < by_rank.size(); r++) {
+            Team& team = *by_rank[r];
+            string joined;
+            for (size_t i = 0; i < problem_names.size(); i++) {
+                cells[i] = problem_cell(team, i);
+                joined += " " + cells[i];
+            }
+            // A jury penalty can change the row without touching the cells
+            string stats = to_string(team.solved_count) + " " + to_string(team.penalty_time) + joined;
+            snapshot->row_offsets[team.id] = text.size();
+            text += team.name + " " + rank_label(team) + " " + stats + "\n";
+            string row = team_json(team, cells);
+            json += (r ? "," : "") + row;
+
+            bool changed = false;
+            if (stats != team.published_stats || !team.published_row) {
+                rows += (rows.empty() ? "" : ",") + row;
+                team.published_stats = stats;
+                team.published_row = true;
+                changed = true;
+            }
+            if (team.ranking != team.published_rank) {
+                changed = true;
+                moves += (moves.empty() ? "{\"name\":\"" : ",{\"name\":\"") + team.name
+                         + "\",\"from\":" + to_string(team.published_rank)
+                         + ",\"to\":" + to_string(team.ranking) + "}";
+                team.published_rank = team.ranking;
+            }
+            if (changed) {
+                snapshot->changed_teams.push_back(team.id);
             }
+        }
+        json += "]}";
+        // Disqualified teams have no row; point them past the end of the board
+        for (Team* team : team_by_id) {
+            if (team->listing != DISQUALIFIED) continue;
+            snapshot->row_offsets[team->id] = text.size();
+            if (team->published_row) {
+                removed += (removed.empty() ? "\"" : ",\"") + team->name + "\"";
+                team->published_row = false;
+                team->published_rank = 0;
+                snapshot->changed_teams.push_back(team->id);
+            }
+        }
 
-            return a < b;
-        });
+        if (flush_version > 0) {
+            snapshot->delta = "{\"from\":" + to_string(flush_version - 1)
+                              + ",\"version\":" + to_string(flush_version)
+                              + ",\"frozen\":" + (is_frozen ? "true" : "false")
+                              + ",\"rows\":[" + rows + "],\"moves\":[" + moves
+                              + "],\"removed\":[" + removed + "]}";
+        }
+
+        published = snapshot;
+        server->publish(snapshot);
+    }
+
+    void print_scoreboard() {
+        // Pre-calculate all stats
+        for (auto& tp : teams) {
+            calculate_team_stats(tp.second, false);
+        }
 
-        for (auto& team_name : sorted_teams) {
-            Team& team = teams[team_name];
+        vector<int>& board = scroll_space.board;
+        board.clear();
+        for (Team* team : team_by_id) {
+            if (team->listing != DISQUALIFIED) board.push_back(team->id);
+        }
+        sort(board.begin(), board.end(), StatsLess{&team_by_id});
 
-            cout << team_name << " " << team.ranking << " "
+        for (int id : board) {
+            Team& team = *team_by_id[id];
+            cout << team.name << " " << rank_label(team) << " "
                  << team.solved_count << " " << team.penalty_time;
 
-            for (auto& pname : problem_names) {
-                cout << " ";
-                if (team.problems.count(pname)) {
-                    ProblemStatus& ps = team.problems[pname];
-                    if (ps.frozen) {
-                        cout << (ps.wrong_attempts_before_freeze == 0 ? "" : "-")
-                             << ps.wrong_attempts_before_freeze << "/"
-                             << ps.submissions_after_freeze;
-                    } else if (ps.solved) {
-                        cout << "+";
-                        if (ps.wrong_attempts_before_first_success > 0) {
-                            cout << ps.wrong_attempts_before_first_success;
-                        }
-                    } else {
-                        int wrong = ps.wrong_attempts_before_freeze;
-                        if (wrong == 0) {
-                            cout << ".";
-                        } else {
-                            cout << "-" << wrong;
-                        }
-                    }
-                } else {
-                    cout << ".";
-                }
+            for (int p = 0; p < problem_count; p++) {
+                cout << " " << problem_cell(team, p);
             }
             cout << "\n";
         }
     }
 
 public:
-    ICPCSystem() : competition_started(false), is_frozen(false), duration_time(0),
-                   problem_count(0), freeze_time(0) {}
+    ICPCSystem() : late_registration(false), competition_started(false), is_frozen(false),
+                   duration_time(0), problem_count(0), freeze_time(0), flush_version(0), cells_issued(0),
+                   server(nullptr),
+                   freeze_begin(0), ranking_index(RankKeyLess{&rank_keys, &team_by_id}),
+                   journal(MAX_UNDO), submit_undos(MAX_UNDO), scroll_space(&team_by_id) {}
+
+    void attach_server(ScoreboardServer* s) {
+        server = s;
+    }
+
+    void allow_late_registration() {
+        late_registration = true;
+    }
 
     void add_team(const string& team_name) {
-        if (competition_started) {
+        if (competition_started && !late_registration) {
             cout << "[Error]Add failed: competition has started.\n";
         } else if (teams.count(team_name)) {
             cout << "[Error]Add failed: duplicated team name.\n";
+        } else if (competition_started) {
+            add_late_team(team_name);
+            clear_journal();
+            cout << "[Info]Add successfully.\n";
         } else {
             teams[team_name] = Team();
             teams[team_name].name = team_name;
+            teams[team_name].id = team_order.size();
             team_order.push_back(team_name);
+            team_by_id.push_back(&teams[team_name]);
+            UndoRecord record;
+            record.kind = UNDO_ADD_TEAM;
+            record_undo(record);
             cout << "[Info]Add successfully.\n";
         }
     }
@@ -213,12 +772,36 @@ public:
                 problem_names.push_back(string(1, 'A' + i));
             }
 
-            // Initialize rankings by lexicographic order
-            vector<string> sorted_teams = team_order;
-            sort(sorted_teams.begin(), sorted_teams.end());
-            for (size_t i = 0; i < sorted_teams.size(); i++) {
-                teams[sorted_teams[i]].ranking = i + 1;
+            // Initialize rankings by lexicographic order; the sorted ids are
+            // kept as the name index for batch and prefix lookups
+            name_index.resize(team_order.size());
+            iota(name_index.begin(), name_index.end(), 0);
+            sort(name_index.begin(), name_index.end(), [this](int a, int b) {
+                return team_order[a] < team_order[b];
+            });
+            // Seal the team set: the name table, the per-id hot arrays and
+            // room for the expected submissions are all sized from N here
+            sealed_names.build(team_order);
+            rank_keys.assign(team_order.size(), RankKey());
+            problem_states.assign(team_order.size() * problems, ProblemStatus());
+            submissions.add_teams(team_order.size());
+            submissions.reserve(team_order.size() * EXPECTED_SUBMISSIONS_PER_TEAM);
+            ranking_index.resize(team_order.size());
+            solved_histogram.assign(problems + 1, 0);
+            first_solves.assign(problems, FirstSolve());
+            scroll_space.standing.resize(team_order.size());
+            scroll_space.frozen_left.reserve(team_order.size());
+            scroll_space.board.reserve(team_order.size());
+            solved_histogram[0] = team_order.size();
+            for (size_t i = 0; i < name_index.size(); i++) {
+                Team* team = team_by_id[name_index[i]];
+                rank_keys[team->id].name_ordinal = (i + 1) * NAME_ORDINAL_GAP;
+                team->ranking = team->flushed_rank = i + 1;
+                team->rank_history.push_back(make_pair(0, team->ranking));
+                ranking_index.insert(team->id);
             }
+            publish_scoreboard();
+            clear_journal();
 
             cout << "[Info]Competition starts.\n";
         }
@@ -226,29 +809,44 @@ public:
 
     void submit(const string& problem, const string& team_name,
                 const string& status, int time) {
-        Team& team = teams[team_name];
-        ProblemStatus& ps = team.problems[problem];
+        Team* found = find_team(team_name);
+        if (!found) return;
+        Team& team = *found;
+        int problem_index = problem[0] - 'A';
+        ProblemStatus& ps = problem_state(team, problem_index);
+        UndoRecord record;
+        record.team = team.id;
+        record.value = problem_index;
+        SubmitUndo before;
+        before.status = ps;
+        before.first = first_solves[problem_index];
+        before.cells = team.cells;
+        record_submit(record, before);
 
         Submission sub;
-        sub.problem = problem;
-        sub.status = status;
+        sub.team = team.id;
         sub.time = time;
+        sub.problem = problem_index;
+        sub.status = parse_status(status);
         sub.before_freeze = !is_frozen;
-        team.submissions.push_back(sub);
+        size_t index = submissions.append(sub);
 
         if (is_frozen) {
             // After freeze, if problem was not solved before freeze, mark as frozen
             if (!ps.solved) {
                 ps.frozen = true;
                 ps.submissions_after_freeze++;
+                mark_dirty(team);
             }
         } else {
             // Before freeze
             if (!ps.solved) {
-                if (status == "Accepted") {
+                mark_dirty(team);
+                if (sub.status == ACCEPTED) {
                     ps.solved = true;
                     ps.solve_time = time;
                     ps.wrong_attempts_before_first_success = ps.wrong_attempts_before_freeze;
+                    record_solve(sub.problem, team.id, time, index);
                 } else {
                     ps.wrong_attempts_before_freeze++;
                 }
@@ -265,25 +863,105 @@ public:
         if (is_frozen) {
             cout << "[Error]Freeze failed: scoreboard has been frozen.\n";
         } else {
+            UndoRecord record;
+            record.kind = UNDO_FREEZE;
+            record.value = freeze_begin;
+            record_undo(record);
+
             is_frozen = true;
             freeze_time = 0; // would need to track actual time if needed
+            freeze_begin = submissions.size();
+            // Problems are marked frozen by the submissions made after this
 
-            // Mark problems as frozen if not solved
-            for (auto& tp : teams) {
-                Team& team = tp.second;
-                for (auto& pp : team.problems) {
-                    ProblemStatus& ps = pp.second;
-                    if (!ps.solved) {
-                        // Problem should be frozen if it has submissions after freeze
-                        // but we'll mark it during submit
-                    }
+            cout << "[Info]Freeze scoreboard.\n";
+        }
+    }
+
+    // Resolves outcomes[begin, end) from the frozen submissions, with one
+    // pass over each team's log. Only reads the store and the problem table,
+    // so ranges can run in parallel.
+    void resolve_frozen(vector<FrozenOutcome>& outcomes, size_t begin, size_t end) const {
+        for (size_t i = begin, next; i < end; i = next) {
+            int team = outcomes[i].team;
+            int slot[26]; // problem -> its outcome, -1 if not frozen
+            fill(slot, slot + 26, -1);
+            for (next = i; next < end && outcomes[next].team == team; next++) {
+                slot[outcomes[next].problem] = next;
+            }
+            submissions.scan(team, -1, -1, [&](size_t idx, const Submission& sub) {
+                if (sub.before_freeze || slot[sub.problem] < 0) return true;
+                FrozenOutcome& out = outcomes[slot[sub.problem]];
+                if (out.solved) return true;
+                if (sub.status != ACCEPTED) {
+                    out.wrong_attempts++;
+                } else {
+                    out.solved = true;
+                    out.solve_time = sub.time;
+                    out.submission = idx;
                 }
+                return true;
+            });
+            for (size_t j = i; j < next; j++) {
+                FrozenOutcome& out = outcomes[j];
+                if (!out.solved) continue;
+                const ProblemStatus& ps = problem_states[(size_t)team * problem_count + out.problem];
+                out.penalty = out.solve_time + 20 * (ps.wrong_attempts_before_freeze + out.wrong_attempts);
             }
+        }
+    }
 
-            cout << "[Info]Freeze scoreboard.\n";
+    // Every frozen problem is independent of the others, so the outcomes are
+    // split across threads the way expected_ranks splits its kernel.
+    void resolve_frozen_outcomes(vector<FrozenOutcome>& outcomes) const {
+        const size_t MIN_OUTCOMES_PER_THREAD = 256;
+        int threads = max(1u, thread::hardware_concurrency());
+        threads = max<int>(1, min<size_t>(threads, outcomes.size() / MIN_OUTCOMES_PER_THREAD + 1));
+        size_t chunk = (outcomes.size() + threads - 1) / threads;
+        vector<thread> workers;
+        workers.reserve(threads - 1);
+        for (int t = 1; t < threads; t++) {
+            size_t begin = t * chunk;
+            size_t end = min(outcomes.size(), begin + chunk);
+            if (begin >= end) continue;
+            try {
+                workers.emplace_back(&ICPCSystem::resolve_frozen, this, ref(outcomes), begin, end);
+            } catch (const system_error&) {
+                // No more threads (process limits, sandboxed judges): the
+                // caller resolves this chunk itself
+                resolve_frozen(outcomes, begin, end);
+            }
+        }
+        resolve_frozen(outcomes, 0, min(chunk, outcomes.size()));
+        for (auto& worker : workers) {
+            worker.join();
         }
     }
 
+    // Unfreezes one problem of a team with its resolved outcome and updates
+    // the team's stats to match.
+    void reveal_problem(Team& team, const FrozenOutcome& outcome) {
+        ProblemStatus& ps = problem_state(team, outcome.problem);
+        ps.frozen = false;
+        mark_dirty(team);
+        if (ps.solved) return;
+
+        if (!outcome.solved) {
+            // Update wrong attempts count (this is for display purposes when not solved)
+            ps.wrong_attempts_before_freeze += outcome.wrong_attempts;
+            return;
+        }
+        ps.solved = true;
+        ps.solve_time = outcome.solve_time;
+        ps.wrong_attempts_before_first_success = ps.wrong_attempts_before_freeze + outcome.wrong_attempts;
+        record_solve(outcome.problem, team.id, outcome.solve_time, outcome.submission);
+
+        team.solved_count++;
+        team.penalty_time += outcome.penalty;
+        team.solve_times.insert(upper_bound(team.solve_times.begin(), team.solve_times.end(),
+                                            outcome.solve_time, greater<int>()),
+                                outcome.solve_time);
+    }
+
     void scroll() {
         if (!is_frozen) {
             cout << "[Error]Scroll failed: scoreboard has not been frozen.\n";
@@ -301,216 +979,698 @@ public:
             calculate_team_stats(tp.second, false);
         }
 
-        // Get initial ranking order
-        vector<string> sorted_teams = team_order;
-        sort(sorted_teams.begin(), sorted_teams.end(), [this](const string& a, const string& b) {
-            Team& t1 = teams[a];
-            Team& t2 = teams[b];
-
-            if (t1.solved_count != t2.solved_count) {
-                return t1.solved_count > t2.solved_count;
-            }
-            if (t1.penalty_time != t2.penalty_time) {
-                return t1.penalty_time < t2.penalty_time;
-            }
-
-            for (size_t i = 0; i < min(t1.solve_times.size(), t2.solve_times.size()); i++) {
-                if (t1.solve_times[i] != t2.solve_times[i]) {
-                    return t1.solve_times[i] < t2.solve_times[i];
+        // Every frozen problem, resolved up front
+        ScrollWorkspace& ws = scroll_space;
+        ws.outcomes.clear();
+        ws.next_outcome.assign(team_by_id.size(), 0);
+        ws.frozen_left.assign(team_by_id.size(), 0);
+        for (Team* team : team_by_id) {
+            ws.next_outcome[team->id] = ws.outcomes.size();
+            for (int p = 0; p < problem_count; p++) {
+                if (problem_state(*team, p).frozen) {
+                    ws.outcomes.push_back(FrozenOutcome(team->id, p));
+                    ws.frozen_left[team->id]++;
                 }
             }
+        }
+        resolve_frozen_outcomes(ws.outcomes);
 
-            return a < b;
-        });
-
-        // Scroll process: unfreeze problems one by one
-        while (true) {
+        // Initial standing of the ranked teams; only they take part
+        ws.standing.resize(team_by_id.size()); // late teams since START
+        for (Team* team : team_by_id) {
+            if (team->listing == RANKED) ws.standing.insert(team->id);
+        }
 
+        // Scroll process: unfreeze problems one by one. Teams below the
+        // cursor have nothing frozen, and a revealed team only moves up, so
+        // the cursor never moves down. Each step is a few O(log N) index
+        // operations, however far the team moves.
+        ws.events.clear();
+        for (int cursor = ws.standing.size();; ) {
             // Find lowest ranked team with frozen problems
-            string lowest_team = "";
-            for (int i = sorted_teams.size() - 1; i >= 0; i--) {
-                Team& team = teams[sorted_teams[i]];
-                bool has_frozen = false;
-                for (auto& pp : team.problems) {
-                    if (pp.second.frozen) {
-                        has_frozen = true;
-                        break;
-                    }
-                }
-                if (has_frozen) {
-                    lowest_team = sorted_teams[i];
-                    break;
-                }
-            }
+            while (cursor >= 1 && ws.frozen_left[ws.standing.at(cursor)] == 0) cursor--;
+            if (cursor < 1) break;
 
-            if (lowest_team.empty()) break;
+            // Its smallest frozen problem is its next outcome; revealing it
+            // also updates the team's stats, so it leaves the index meanwhile
+            Team& team = *team_by_id[ws.standing.at(cursor)];
+            int old_rank = cursor;
 
-            // Find smallest problem number that is frozen
-            Team& team = teams[lowest_team];
-            string unfreeze_problem = "";
-            for (auto& pname : problem_names) {
-                if (team.problems[pname].frozen) {
-                    unfreeze_problem = pname;
-                    break;
-                }
-            }
+            ws.standing.erase(team.id);
+            reveal_problem(team, ws.outcomes[ws.next_outcome[team.id]++]);
+            ws.frozen_left[team.id]--;
+            ws.standing.insert(team.id);
 
-            int old_rank = team.ranking;
-
-            // Unfreeze and process submissions
-            ProblemStatus& ps = team.problems[unfreeze_problem];
-            ps.frozen = false;
-
-            // Process frozen submissions
-            int additional_wrong_attempts = 0;
-            for (auto& sub : team.submissions) {
-                if (sub.problem == unfreeze_problem && !sub.before_freeze) {
-                    if (!ps.solved) {
-                        if (sub.status == "Accepted") {
-                            ps.solved = true;
-                            ps.solve_time = sub.time;
-                            ps.wrong_attempts_before_first_success = ps.wrong_attempts_before_freeze + additional_wrong_attempts;
-                        } else {
-                            additional_wrong_attempts++;
-                        }
-                    }
-                }
-            }
-            // Update wrong attempts count (this is for display purposes when not solved)
-            if (!ps.solved) {
-                ps.wrong_attempts_before_freeze += additional_wrong_attempts;
-            }
+            int new_rank = ws.standing.rank(team.id);
 
-            // Save old rankings before recalculating
-            map<string, int> old_rankings;
-            for (auto& name : sorted_teams) {
-                old_rankings[name] = teams[name].ranking;
+            // If ranking changed, output the change along with the team that
+            // was at the new rank before and is now right below it
+            if (new_rank < old_rank) {
+                const Team& replaced = *team_by_id[ws.standing.at(new_rank + 1)];
+                ws.events += team.name;
+                ws.events += ' ';
+                ws.events += replaced.name;
+                ws.events += ' ';
+                ws.events += to_string(team.solved_count);
+                ws.events += ' ';
+                ws.events += to_string(team.penalty_time);
+                ws.events += '\n';
             }
+        }
+        int rank = 0;
+        ws.standing.for_each([&](int id) { team_by_id[id]->ranking = ++rank; });
+        ws.standing.clear();
+        cout << ws.events;
 
-            // Recalculate stats only for the changed team
-            calculate_team_stats(team, false);
+        // Unranked teams are revealed all at once, without moving anyone
+        for (auto& tp : teams) {
+            Team& t = tp.second;
+            if (t.listing == RANKED) continue;
+            for (; ws.frozen_left[t.id] > 0; ws.frozen_left[t.id]--) {
+                reveal_problem(t, ws.outcomes[ws.next_outcome[t.id]++]);
+            }
+            calculate_team_stats(t, false);
+        }
 
-            // Re-sort to get new rankings
-            sort(sorted_teams.begin(), sorted_teams.end(), [this](const string& a, const string& b) {
-                Team& t1 = teams[a];
-                Team& t2 = teams[b];
+        // Print final scoreboard
+        print_scoreboard();
 
-                if (t1.solved_count != t2.solved_count) {
-                    return t1.solved_count > t2.solved_count;
-                }
-                if (t1.penalty_time != t2.penalty_time) {
-                    return t1.penalty_time < t2.penalty_time;
-                }
+        is_frozen = false;
+        refresh_ranking_index();
+        commit_flush();
 
-                for (size_t i = 0; i < min(t1.solve_times.size(), t2.solve_times.size()); i++) {
-                    if (t1.solve_times[i] != t2.solve_times[i]) {
-                        return t1.solve_times[i] < t2.solve_times[i];
-                    }
-                }
+        clear_journal();
 
-                return a < b;
-            });
+        // Reset frozen submission counts for all teams
+        for (ProblemStatus& ps : problem_states) {
+            ps.submissions_after_freeze = 0;
+        }
+    }
 
-            // Update rankings
-            for (size_t i = 0; i < sorted_teams.size(); i++) {
-                teams[sorted_teams[i]].ranking = i + 1;
+    void query_ranking(const string& team_name) {
+        Team* team = find_team(team_name);
+        if (!team) {
+            cout << "[Error]Query ranking failed: cannot find the team.\n";
+        } else if (team->listing != RANKED) {
+            cout << "[Error]Query ranking failed: team is not ranked.\n";
+        } else {
+            cout << "[Info]Complete query ranking.\n";
+            if (is_frozen) {
+                cout << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
             }
+            cout << team_name << " NOW AT RANKING " << team->ranking << "\n";
+        }
+    }
 
-            int new_rank = team.ranking;
+    // Undoes the last n journaled commands, newest first. START, SCROLL and
+    // late registrations cannot be undone and clear the journal.
+    void undo(int n) {
+        if (n <= 0 || journal.empty()) {
+            cout << "[Error]Undo failed: nothing to undo.\n";
+            return;
+        }
+        int done = 0;
+        for (; done < n && !journal.empty(); done++) {
+            undo_one(journal.back());
+            journal.pop_back();
+        }
+        cout << "[Info]Undo " << done << " commands.\n";
+    }
 
-            // If ranking changed, output the change
-            if (new_rank < old_rank) {
-                // Find the team that was at the new_rank position before this change
-                // This is the team that lowest_team replaced
-                string replaced_team = "";
-                for (auto& name : sorted_teams) {
-                    if (old_rankings[name] == new_rank && name != lowest_team) {
-                        replaced_team = name;
-                        break;
-                    }
+    // Takes a team out of the ranking; the index drops it at the next flush.
+    void disqualify(const string& team_name) {
+        Team* team = find_team(team_name);
+        if (!team) {
+            cout << "[Error]Disqualify failed: cannot find the team.\n";
+        } else if (!competition_started) {
+            cout << "[Error]Disqualify failed: competition has not started.\n";
+        } else if (team->listing == DISQUALIFIED) {
+            cout << "[Error]Disqualify failed: team has been disqualified.\n";
+        } else {
+            record_listing(*team);
+            team->listing = DISQUALIFIED;
+            mark_stale(*team);
+            cout << "[Info]Disqualify team.\n";
+        }
+    }
+
+    // Adds (or with a negative value waives) jury penalty minutes. The team is
+    // re-keyed and moved in the ranking index at the next flush.
+    void adjust_penalty(const string& team_name, int minutes) {
+        Team* team = find_team(team_name);
+        if (!team) {
+            cout << "[Error]Penalty failed: cannot find the team.\n";
+        } else if (!competition_started) {
+            cout << "[Error]Penalty failed: competition has not started.\n";
+        } else {
+            UndoRecord record;
+            record.kind = UNDO_PENALTY;
+            record.team = team->id;
+            record.value = minutes;
+            record_undo(record);
+            team->penalty_offset += minutes;
+            mark_stale(*team);
+            cout << "[Info]Adjust penalty.\n";
+        }
+    }
+
+    // Keeps a team on the board without a rank, from the next flush on.
+    void hide(const string& team_name) {
+        Team* team = find_team(team_name);
+        if (!team) {
+            cout << "[Error]Hide failed: cannot find the team.\n";
+        } else if (!competition_started) {
+            cout << "[Error]Hide failed: competition has not started.\n";
+        } else if (team->listing != RANKED) {
+            cout << "[Error]Hide failed: team is not ranked.\n";
+        } else {
+            record_listing(*team);
+            team->listing = HIDDEN;
+            mark_stale(*team);
+            cout << "[Info]Hide team.\n";
+        }
+    }
+
+    // Ranks of many teams in one response line ("name rank", "?" for unknown
+    // names). The queried names are sorted once and merged against the name
+    // index, so every lookup resumes where the previous one stopped instead
+    // of walking the team map from its root.
+    void query_rankings(const vector<string>& names) {
+        vector<int> order(names.size());
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&names](int a, int b) { return names[a] < names[b]; });
+
+        vector<int> found(names.size(), -1);
+        auto from = name_index.begin();
+        for (int q : order) {
+            from = lower_bound(from, name_index.end(), names[q], [this](int id, const string& name) {
+                return team_order[id] < name;
+            });
+            if (from != name_index.end() && team_order[*from] == names[q]) {
+                found[q] = *from;
+            } else if (!late_names.empty()) {
+                auto late = late_names.find(names[q]);
+                if (late != late_names.end()) {
+                    found[q] = late->second;
                 }
+            }
+        }
+
+        string out = "[Info]Complete query rankings.\n";
+        if (is_frozen) {
+            out += "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
+        }
+        for (size_t i = 0; i < names.size(); i++) {
+            out += (i ? " " : "") + names[i] + " "
+                   + (found[i] < 0 ? "?"
+                      : team_by_id[found[i]]->listing != RANKED ? "*"
+                      : to_string(team_by_id[found[i]]->ranking));
+        }
+        out += "\n";
+        cout << out;
+    }
 
-                calculate_team_stats(team, false);
-                cout << lowest_team << " " << replaced_team << " "
-                     << team.solved_count << " " << team.penalty_time << "\n";
+    // Up to k team names starting with prefix, in lexicographic order: one
+    // binary search on the name index, then a forward walk. Before START the
+    // name index is not built yet and the team map is walked instead.
+    void query_teams(const string& prefix, int k) {
+        cout << "[Info]Complete query teams.\n";
+        if (!competition_started) {
+            int shown = 0;
+            for (auto t = teams.lower_bound(prefix);
+                 shown < k && t != teams.end() && t->first.compare(0, prefix.size(), prefix) == 0;
+                 ++t, ++shown) {
+                cout << t->first << "\n";
+            }
+            if (shown == 0) {
+                cout << "Cannot find any team.\n";
+            }
+            return;
+        }
+        auto it = lower_bound(name_index.begin(), name_index.end(), prefix,
+                              [this](int id, const string& p) { return team_order[id] < p; });
+        auto late = late_names.lower_bound(prefix);
+        int shown = 0;
+        // Late teams are merged in from their own map
+        for (; shown < k; ++shown) {
+            bool from_late = late != late_names.end() &&
+                             (it == name_index.end() || late->first < team_order[*it]);
+            if (!from_late && it == name_index.end()) break;
+            const string& name = from_late ? late->first : team_order[*it];
+            if (name.compare(0, prefix.size(), prefix) != 0) break;
+            cout << name << "\n";
+            if (from_late) {
+                ++late;
+            } else {
+                ++it;
             }
         }
+        if (shown == 0) {
+            cout << "Cannot find any team.\n";
+        }
+    }
 
-        // Print final scoreboard
-        print_scoreboard();
+    // Flushed team counts per solved count, with the running "solved at
+    // least k" total used for medal lines: "k exactly at_least", k from M to 0.
+    void query_distribution() {
+        if (!competition_started) {
+            cout << "[Error]Query distribution failed: competition has not started.\n";
+            return;
+        }
+        cout << "[Info]Complete query distribution.\n";
+        if (is_frozen) {
+            cout << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
+        }
+        int at_least = 0;
+        for (int k = problem_count; k >= 0; k--) {
+            at_least += solved_histogram[k];
+            cout << k << " " << solved_histogram[k] << " " << at_least << "\n";
+        }
+    }
 
-        is_frozen = false;
+    // Live and reserved heap bytes per engine structure, "name live reserved",
+    // then the process's resident set size and its peak.
+    void memory_stats() {
+        MemoryUsage team_records, names, problem_state, render_cache, output_buffers, undo;
 
-        // Reset frozen submission counts for all teams
         for (auto& tp : teams) {
-            Team& t = tp.second;
-            for (auto& pp : t.problems) {
-                ProblemStatus& ps = pp.second;
-                ps.submissions_after_freeze = 0;
+            const Team& team = tp.second;
+            size_t node = MAP_NODE_HEADER + sizeof(tp);
+            team_records += MemoryUsage(node, node);
+            team_records += string_usage(tp.first);
+            team_records += string_usage(team.name);
+            team_records += vector_usage(team.solve_times);
+            team_records += vector_usage(team.key_solve_times);
+            team_records += vector_usage(team.rank_history);
+            team_records += vector_usage(team.cell_history);
+            render_cache += string_usage(team.published_stats);
+        }
+        team_records += vector_usage(team_order);
+        for (auto& name : team_order) team_records += string_usage(name);
+        team_records += vector_usage(team_by_id);
+        team_records += vector_usage(stale_teams);
+
+        names += sealed_names.memory();
+        names += vector_usage(name_index);
+        for (auto& late : late_names) {
+            size_t node = MAP_NODE_HEADER + sizeof(late);
+            names += MemoryUsage(node, node);
+            names += string_usage(late.first);
+        }
+        if (team_ids) {
+            size_t buckets = team_ids->bucket_count() * sizeof(void*);
+            names += MemoryUsage(0, buckets);
+            for (auto& entry : *team_ids) {
+                size_t node = HASH_NODE_HEADER + sizeof(entry);
+                names += MemoryUsage(node, node);
+                names += string_usage(entry.first);
             }
         }
-    }
 
-    void query_ranking(const string& team_name) {
-        if (!teams.count(team_name)) {
-            cout << "[Error]Query ranking failed: cannot find the team.\n";
+        problem_state += vector_usage(problem_states);
+        problem_state += vector_usage(first_solves);
+        problem_state += vector_usage(solved_histogram);
+
+        MemoryUsage ranking = ranking_index.memory();
+        ranking += vector_usage(rank_keys);
+
+        if (published) {
+            render_cache += string_usage(published->text);
+            render_cache += string_usage(published->json);
+            render_cache += string_usage(published->delta);
+            render_cache += vector_usage(published->row_offsets);
+            render_cache += vector_usage(published->changed_teams);
+        }
+        // cout writes through one BUFSIZ stdio buffer once it is no longer
+        // synchronised with C stdio.
+        output_buffers += MemoryUsage(BUFSIZ, BUFSIZ);
+
+        undo += journal.memory();
+        undo += submit_undos.memory();
+
+        pair<const char*, MemoryUsage> rows[] = {
+            {"team_records", team_records},
+            {"name_index", names},
+            {"problem_state", problem_state},
+            {"submission_log", submissions.memory()},
+            {"ranking_index", ranking},
+            {"scroll_workspace", scroll_space.memory()},
+            {"render_cache", render_cache},
+            {"output_buffers", output_buffers},
+            {"undo_journal", undo},
+        };
+        MemoryUsage total;
+        cout << "[Info]Complete memory stats.\n";
+        for (auto& row : rows) {
+            cout << row.first << " " << row.second.live << " " << row.second.reserved << "\n";
+            total += row.second;
+        }
+        cout << "total " << total.live << " " << total.reserved << "\n";
+        size_t rss = 0, peak = 0;
+        if (process_memory(rss, peak)) {
+            cout << "rss " << rss << "\n" << "peak_rss " << peak << "\n";
         } else {
-            cout << "[Info]Complete query ranking.\n";
-            if (is_frozen) {
-                cout << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
-            }
-            cout << team_name << " NOW AT RANKING " << teams[team_name].ranking << "\n";
+            cout << "[Warning]Process memory is unavailable.\n";
         }
     }
 
+    // The team at flushed rank r with its solved count and penalty.
+    void query_at_rank(int r) {
+        int id = ranking_index.at(r);
+        if (id < 0) {
+            cout << "[Error]Query at rank failed: rank out of range.\n";
+            return;
+        }
+        cout << "[Info]Complete query at rank.\n";
+        if (is_frozen) {
+            cout << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
+        }
+        Team& team = *team_by_id[id];
+        cout << team.name << " " << r << " " << rank_keys[id].solved << " " << rank_keys[id].penalty
+             << "\n";
+    }
+
     void query_submission(const string& team_name, const string& problem, const string& status) {
-        if (!teams.count(team_name)) {
+        Team* found_team = find_team(team_name);
+        if (!found_team) {
             cout << "[Error]Query submission failed: cannot find the team.\n";
         } else {
             cout << "[Info]Complete query submission.\n";
 
-            Team& team = teams[team_name];
-            Submission* found = nullptr;
+            Team& team = *found_team;
+            int problem_index = problem == "ALL" ? -1 : problem[0] - 'A';
+            int status_index = status == "ALL" ? -1 : parse_status(status);
+            Submission found;
+
+            if (submissions.find_last(team.id, problem_index, status_index, found)) {
+                cout << team_name << " " << problem_names[found.problem] << " "
+                     << STATUS_NAMES[found.status] << " " << found.time << "\n";
+            } else {
+                cout << "Cannot find any submission.\n";
+            }
+        }
+    }
+
+    // All submissions of a team matching the filter with from <= time <= to,
+    // oldest first: the times map to an arrival index range, and only the
+    // team's blocks that overlap it and can match are decoded.
+    void query_submission_range(const string& team_name, const string& problem,
+                                const string& status, int from_time, int to_time) {
+        Team* found_team = find_team(team_name);
+        if (!found_team) {
+            cout << "[Error]Query submission failed: cannot find the team.\n";
+            return;
+        }
+        cout << "[Info]Complete query submission.\n";
+
+        Team& team = *found_team;
+        int problem_index = problem == "ALL" ? -1 : problem[0] - 'A';
+        int status_index = status == "ALL" ? -1 : parse_status(status);
+        bool any = false;
+        submissions.scan(team.id, problem_index, status_index, submissions.first_at_or_after(from_time),
+                         submissions.first_after(to_time), [&](size_t, const Submission& sub) {
+            cout << team_name << " " << problem_names[sub.problem] << " "
+                 << STATUS_NAMES[sub.status] << " " << sub.time << "\n";
+            any = true;
+            return true;
+        });
+        if (!any) {
+            cout << "Cannot find any submission.\n";
+        }
+    }
+
+    // The latest k submissions across all teams, newest first, usually read
+    // from the store's ring of recent submissions. In public mode verdicts
+    // of submissions made during the current freeze are hidden.
+    void query_recent(int k, bool public_only) {
+        cout << "[Info]Complete query recent.\n";
+        if (submissions.empty() || k <= 0) {
+            cout << "Cannot find any submission.\n";
+            return;
+        }
+        submissions.for_each_recent(k, [&](size_t i, const Submission& sub) {
+            bool hidden = public_only && is_frozen && i >= freeze_begin;
+            cout << team_order[sub.team] << " " << problem_names[sub.problem] << " "
+                 << (hidden ? "Hidden" : STATUS_NAMES[sub.status]) << " " << sub.time << "\n";
+        });
+    }
+
+    // Teams whose rank or cells differ between two flush versions. Both can
+    // come back (ranks as others move, cells through UNDO), so each is
+    // compared through its recorded changes. Teams untouched since v1 are
+    // skipped on their last-modified version.
+    void query_diff(int v1, int v2) {
+        if (v1 < 0 || v1 > v2 || v2 > flush_version) {
+            cout << "[Error]Query diff failed: invalid flush version.\n";
+            return;
+        }
+        cout << "[Info]Complete query diff.\n";
+
+        vector<pair<int, Team*>> changed; // (rank at v2, team)
+        for (Team* team : team_by_id) {
+            if (team->last_modified <= v1) continue;
+            if (cells_at(*team, v1) != cells_at(*team, v2) ||
+                rank_at(*team, v1) != rank_at(*team, v2)) {
+                changed.push_back(make_pair(rank_at(*team, v2), team));
+            }
+        }
+        if (changed.empty()) {
+            cout << "No team changed.\n";
+            return;
+        }
+        // Unranked teams all share rank 0; they follow by name
+        sort(changed.begin(), changed.end(), [](const pair<int, Team*>& a, const pair<int, Team*>& b) {
+            return a.first != b.first ? a.first < b.first : a.second->name < b.second->name;
+        });
+        for (auto& c : changed) {
+            Team& team = *c.second;
+            bool cells_changed = cells_at(team, v1) != cells_at(team, v2);
+            cout << team.name << " " << rank_at(team, v1) << " " << c.first
+                 << (cells_changed ? " CELLS_CHANGED\n" : " CELLS_SAME\n");
+        }
+    }
+
+    void set_export_path(const string& path) {
+        export_path = path;
+    }
 
-            for (int i = team.submissions.size() - 1; i >= 0; i--) {
-                Submission& sub = team.submissions[i];
-                bool match = true;
+    void set_awards_path(const string& path) {
+        awards_path = path;
+    }
 
-                if (problem != "ALL" && sub.problem != problem) {
-                    match = false;
+    // Reads "team_name group_name" lines; teams not listed belong to no group.
+    bool load_groups(const string& path) {
+        ifstream in(path);
+        if (!in) {
+            return false;
+        }
+        string team_name, group;
+        while (in >> team_name >> group) {
+            team_groups[team_name] = group;
+        }
+        return true;
+    }
+
+    // Final standings report in one pass over the ranking plus one over the
+    // problems. Medals go to teams that solved at least one problem: the top
+    // 10% (rounded up) gold, the next 20% silver, the next 30% bronze.
+    //
+    //   MEDAL <GOLD|SILVER|BRONZE> team rank solved penalty
+    //   CUTOFF <medal> solved penalty      (last team of that medal)
+    //   FIRST_SOLVE problem team time      ("-" if nobody solved it)
+    //   GROUP_WINNER group team rank
+    string award_report() {
+        // The final standings include everything submitted since the last flush
+        refresh_ranking_index();
+
+        int eligible = 0;
+        for (int k = 1; k <= problem_count; k++) {
+            eligible += solved_histogram[k];
+        }
+        const char* medals[] = {"GOLD", "SILVER", "BRONZE"};
+        int percent[] = {10, 30, 60}; // cumulative
+        int limits[3];
+        for (int m = 0; m < 3; m++) {
+            limits[m] = (eligible * percent[m] + 99) / 100;
+        }
+
+        string report, cutoffs, groups;
+        unordered_map<string, bool> group_done;
+        int rank = 0;
+        ranking_index.for_each([&](int id) {
+            Team& team = *team_by_id[id];
+            rank++;
+            const RankKey& key = rank_keys[id];
+            string stats = to_string(key.solved) + " " + to_string(key.penalty);
+            int medal = 0;
+            while (medal < 3 && rank > limits[medal]) medal++;
+            if (medal < 3 && key.solved > 0) {
+                report += string("MEDAL ") + medals[medal] + " " + team.name + " " + to_string(rank)
+                          + " " + stats + "\n";
+                if (rank == limits[medal]) {
+                    cutoffs += string("CUTOFF ") + medals[medal] + " " + stats + "\n";
                 }
-                if (status != "ALL" && sub.status != status) {
-                    match = false;
+            }
+            auto group = team_groups.find(team.name);
+            if (group != team_groups.end() && !group_done[group->second]) {
+                group_done[group->second] = true;
+                groups += "GROUP_WINNER " + group->second + " " + team.name + " " + to_string(rank) + "\n";
+            }
+        });
+        report += cutoffs;
+        for (int p = 0; p < problem_count; p++) {
+            FirstSolve first = first_solves[p];
+            if (first.team >= 0 && team_by_id[first.team]->listing != RANKED) {
+                first = first_ranked_solve(p);
+            }
+            report += "FIRST_SOLVE " + problem_names[p] + " "
+                      + (first.team < 0 ? "-" : team_order[first.team] + " " + to_string(first.time)) + "\n";
+        }
+        return report + groups;
+    }
+
+    // Earliest visible solve of a problem by a ranked team, for when the
+    // recorded first solver has been hidden or disqualified.
+    FirstSolve first_ranked_solve(int problem) {
+        FirstSolve first;
+        for (Team* team : team_by_id) {
+            const ProblemStatus& ps = problem_state(*team, problem);
+            if (team->listing != RANKED || !ps.solved || ps.frozen) {
+                continue;
+            }
+            submissions.scan(team->id, problem, ACCEPTED, [&](size_t idx, const Submission& sub) {
+                if (first.team < 0 || sub.time < first.time ||
+                    (sub.time == first.time && (int)idx < first.submission)) {
+                    first.team = team->id;
+                    first.time = sub.time;
+                    first.submission = idx;
                 }
+                return false;
+            });
+        }
+        return first;
+    }
 
-                if (match) {
-                    found = &sub;
+    void set_rating_paths(const string& in, const string& out) {
+        ratings_in = in;
+        ratings_out = out;
+    }
+
+    // Reads "team_name rating" lines (unlisted teams start at 1500) and writes
+    // "team_name old_rating delta new_rating" in final ranking order.
+    bool write_rating_update() {
+        const int INITIAL_RATING = 1500;
+        unordered_map<string, int> known;
+        ifstream in(ratings_in);
+        if (!in) {
+            return false;
+        }
+        string team_name;
+        int rating;
+        while (in >> team_name >> rating) {
+            known[team_name] = rating;
+        }
+
+        refresh_ranking_index();
+        vector<int> order, ratings;
+        ranking_index.for_each([&](int id) {
+            auto it = known.find(team_order[id]);
+            order.push_back(id);
+            ratings.push_back(it == known.end() ? INITIAL_RATING : it->second);
+        });
+        // Teams that only differ by name share the average of their ranks
+        vector<double> ranks(order.size());
+        for (size_t first = 0, last; first < order.size(); first = last) {
+            const RankKey& key = rank_keys[order[first]];
+            for (last = first + 1; last < order.size(); last++) {
+                const RankKey& other = rank_keys[order[last]];
+                if (other.solved != key.solved || other.penalty != key.penalty ||
+                    team_by_id[order[last]]->key_solve_times !=
+                        team_by_id[order[first]]->key_solve_times) {
                     break;
                 }
             }
+            fill(ranks.begin() + first, ranks.begin() + last, (first + last + 1) / 2.0);
+        }
+        vector<int> deltas = rating_deltas(ratings, ranks, 0);
 
-            if (found) {
-                cout << team_name << " " << found->problem << " "
-                     << found->status << " " << found->time << "\n";
-            } else {
-                cout << "Cannot find any submission.\n";
-            }
+        string report;
+        for (size_t i = 0; i < order.size(); i++) {
+            report += team_order[order[i]] + " " + to_string(ratings[i]) + " " + to_string(deltas[i])
+                      + " " + to_string(ratings[i] + deltas[i]) + "\n";
+        }
+        ofstream out(ratings_out);
+        out << report;
+        return (bool)out;
+    }
+
+    // Every team's final rank and key, including what was submitted since the
+    // last flush. Nobody has a rank in a contest that never started.
+    vector<FinalStanding> final_standings() {
+        vector<FinalStanding> standings(team_by_id.size());
+        if (!competition_started) return standings;
+        refresh_ranking_index();
+        for (size_t id = 0; id < team_by_id.size(); id++) {
+            standings[id].rank = team_by_id[id]->ranking;
+            standings[id].solved = rank_keys[id].solved;
+            standings[id].penalty = rank_keys[id].penalty;
         }
+        return standings;
     }
 
     void end_competition() {
         cout << "[Info]Competition ends.\n";
+
+        if (!export_path.empty()) {
+            vector<Submission> rows;
+            submissions.decode_all(rows);
+            if (!write_submission_log(export_path, team_order, problem_count, rows.data(), rows.size(),
+                                      final_standings())) {
+                cerr << "cannot write submission log to " << export_path << "\n";
+            }
+        }
+        if (!awards_path.empty()) {
+            ofstream out(awards_path);
+            out << award_report();
+            if (!out) {
+                cerr << "cannot write award report to " << awards_path << "\n";
+            }
+        }
+        if (!ratings_out.empty() && !write_rating_update()) {
+            cerr << "cannot update ratings from " << ratings_in << " to " << ratings_out << "\n";
+        }
     }
 };
 
-int main() {
-    ios_base::sync_with_stdio(false);
-    cin.tie(nullptr);
+// Command lines from stdin, or from a FORK block already read into memory.
+class CommandReader {
+public:
+    explicit CommandReader(istream& in) : in(&in), pos(0) {}
+    explicit CommandReader(vector<string> lines) : in(nullptr), lines(move(lines)), pos(0) {}
 
-    ICPCSystem system;
-    string line;
+    bool next(string& line) {
+        if (in) {
+            return (bool)getline(*in, line);
+        }
+        if (pos == lines.size()) {
+            return false;
+        }
+        line = lines[pos++];
+        return true;
+    }
+
+private:
+    istream* in;
+    vector<string> lines;
+    size_t pos;
+};
+
+void run_fork(ICPCSystem& system, CommandReader& reader);
 
-    while (getline(cin, line)) {
+// Runs commands until END (returns true) or the end of the input.
+bool run_commands(ICPCSystem& system, CommandReader& reader) {
+    string line;
+    while (reader.next(line)) {
         if (line.empty()) continue;
 
         istringstream iss(line);
@@ -541,6 +1701,41 @@ int main() {
             string team_name;
             iss >> team_name;
             system.query_ranking(team_name);
+        } else if (command == "QUERY_RANKINGS") {
+            vector<string> names;
+            string team_name;
+            while (iss >> team_name) {
+                names.push_back(team_name);
+            }
+            system.query_rankings(names);
+        } else if (command == "QUERY_TEAMS") {
+            // QUERY_TEAMS PREFIX p LIMIT k; the prefix may be empty, so it is
+            // taken by position and may itself be "LIMIT"
+            vector<string> args;
+            string arg;
+            while (iss >> arg) {
+                args.push_back(arg);
+            }
+            string prefix = args.size() == 4 ? args[1] : "";
+            int limit = args.empty() ? 0 : atoi(args.back().c_str());
+            system.query_teams(prefix, limit);
+        } else if (command == "QUERY_DISTRIBUTION") {
+            system.query_distribution();
+        } else if (command == "MEMSTATS") {
+            system.memory_stats();
+        } else if (command == "QUERY_AT_RANK") {
+            int r = 0;
+            iss >> r;
+            system.query_at_rank(r);
+        } else if (command == "QUERY_DIFF") {
+            int v1 = -1, v2 = -1;
+            iss >> v1 >> v2;
+            system.query_diff(v1, v2);
+        } else if (command == "QUERY_RECENT") {
+            int k = 0;
+            string mode;
+            iss >> k >> mode;
+            system.query_recent(k, mode == "PUBLIC");
         } else if (command == "QUERY_SUBMISSION") {
             string team_name, where, problem_eq, and_str, status_eq;
             iss >> team_name >> where >> problem_eq >> and_str >> status_eq;
@@ -548,12 +1743,155 @@ int main() {
             string problem = problem_eq.substr(8); // skip "PROBLEM="
             string status = status_eq.substr(7);   // skip "STATUS="
 
-            system.query_submission(team_name, problem, status);
+            // Optional "AND TIME=from-to" lists every match in that range.
+            string and_time, time_eq;
+            if (iss >> and_time >> time_eq && time_eq.compare(0, 5, "TIME=") == 0) {
+                int from_time = 0, to_time = 0;
+                char dash;
+                istringstream(time_eq.substr(5)) >> from_time >> dash >> to_time;
+                system.query_submission_range(team_name, problem, status, from_time, to_time);
+            } else {
+                system.query_submission(team_name, problem, status);
+            }
         } else if (command == "END") {
             system.end_competition();
-            break;
+            return true;
+        } else if (command == "DISQUALIFY") {
+            string team_name;
+            iss >> team_name;
+            system.disqualify(team_name);
+        } else if (command == "HIDE") {
+            string team_name;
+            iss >> team_name;
+            system.hide(team_name);
+        } else if (command == "PENALTY") {
+            // PENALTY team +minutes / -minutes
+            string team_name;
+            int minutes = 0;
+            iss >> team_name >> minutes;
+            system.adjust_penalty(team_name, minutes);
+        } else if (command == "UNDO") {
+            int n = 0;
+            iss >> n;
+            system.undo(n);
+        } else if (command == "FORK") {
+            run_fork(system, reader);
         }
     }
+    return false;
+}
 
+// FORK ... DISCARD runs the enclosed commands against a copy of the whole
+// contest and then throws the copy away. The copy is a child process: the
+// kernel shares every page copy-on-write, so forking costs no more than
+// copying the page tables, a branch pays only for the pages it touches, and
+// discarding it is an exit. The parent reads the block up to the matching
+// DISCARD (blocks nest) and resumes after it once the child is done. An END
+// in a block ends the branch without writing any side file, and a branch
+// that crashes is reported.
+void run_fork(ICPCSystem& system, CommandReader& reader) {
+    vector<string> block;
+    string line;
+    int depth = 1;
+    while (reader.next(line)) {
+        istringstream iss(line);
+        string command;
+        iss >> command;
+        depth += (command == "FORK") - (command == "DISCARD");
+        if (depth == 0) break;
+        block.push_back(line);
+    }
+
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        cout << "[Error]Fork failed: " << strerror(errno) << ".\n";
+        return;
+    }
+    if (pid == 0) {
+        // Only this thread was copied; the branch must not reach the server.
+        system.attach_server(nullptr);
+        // An END inside the branch must not write the real side files from
+        // state that is about to be thrown away.
+        system.set_export_path("");
+        system.set_awards_path("");
+        system.set_rating_paths("", "");
+        cout << "[Info]Fork contest.\n";
+        CommandReader branch(move(block));
+        run_commands(system, branch);
+        cout << "[Info]Discard fork.\n";
+        cout.flush();
+        _exit(0);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cout << "[Error]Fork failed: branch did not finish.\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ios_base::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    ICPCSystem system;
+
+    // --serve PORT: also publish every flushed board over HTTP and keep
+    // serving the final board after END until the process is interrupted.
+    unique_ptr<ScoreboardServer> server;
+    bool perf = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            server.reset(new ScoreboardServer(atoi(argv[i + 1])));
+            if (!server->start()) {
+                cerr << "cannot listen on port " << argv[i + 1] << "\n";
+                return 1;
+            }
+            system.attach_server(server.get());
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            // --export FILE: write the columnar submission log at END.
+            system.set_export_path(argv[i + 1]);
+        } else if (strcmp(argv[i], "--awards") == 0 && i + 1 < argc) {
+            // --awards FILE: write medals, first solves and group winners at END.
+            system.set_awards_path(argv[i + 1]);
+        } else if (strcmp(argv[i], "--ratings") == 0 && i + 2 < argc) {
+            // --ratings IN OUT: Elo-style rating update from the final ranking.
+            system.set_rating_paths(argv[i + 1], argv[i + 2]);
+            i++;
+        } else if (strcmp(argv[i], "--groups") == 0 && i + 1 < argc) {
+            // --groups FILE: "team_name group_name" lines for group winners.
+            if (!system.load_groups(argv[i + 1])) {
+                cerr << "cannot read groups from " << argv[i + 1] << "\n";
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--late-registration") == 0) {
+            // --late-registration: ADDTEAM keeps working after START.
+            system.allow_late_registration();
+        } else if (strcmp(argv[i], "--no-huge-pages") == 0) {
+            // --no-huge-pages: back the large arrays with ordinary pages.
+            // Nothing is allocated from them before START.
+            disable_huge_pages();
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            // --perf: report hardware counters of the command loop to stderr.
+            perf = true;
+        }
+    }
+    PerfCounters counters;
+    if (perf) {
+        counters.start();
+    }
+    CommandReader reader(cin);
+    run_commands(system, reader);
+    if (perf) {
+        counters.stop();
+        cout.flush();
+        counters.report(cerr);
+    }
+
+    if (server) {
+        cout.flush();
+        server->join();
+    }
     return 0;
 }
@@ -0,0 +1,22 @@
+#include "memory_stats.h"
+
+#include <fstream>
+
+using namespace std;
+
+bool process_memory(size_t& rss, size_t& peak) {
+    ifstream status("/proc/self/status");
+    string line;
+    int found = 0;
+    while (getline(status, line)) {
+        // "VmRSS:     1234 kB"
+        size_t* field = line.compare(0, 6, "VmRSS:") == 0   ? &rss
+                        : line.compare(0, 6, "VmHWM:") == 0 ? &peak
+                                                             : nullptr;
+        if (field) {
+            *field = stoull(line.substr(6)) * 1024;
+            found++;
+        }
+    }
+    return found == 2;
+}
@@ -0,0 +1,45 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <cstddef>
+#include <string>
+
+// Heap bytes held by a structure: "live" is what its elements occupy,
+// "reserved" what it has allocated (capacity, slack, node headers).
+// Node-based containers are estimated from libstdc++'s node layouts.
+struct MemoryUsage {
+    size_t live;
+    size_t reserved;
+
+    MemoryUsage() : live(0), reserved(0) {}
+    MemoryUsage(size_t live, size_t reserved) : live(live), reserved(reserved) {}
+
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        live += other.live;
+        reserved += other.reserved;
+        return *this;
+    }
+};
+
+// Any vector, whatever its allocator.
+template <class Vector>
+MemoryUsage vector_usage(const Vector& v) {
+    return MemoryUsage(v.size() * sizeof(v[0]), v.capacity() * sizeof(v[0]));
+}
+
+// Short strings live inside the string object and own no heap bytes.
+inline MemoryUsage string_usage(const std::string& s) {
+    static const size_t inline_capacity = std::string().capacity();
+    if (s.capacity() <= inline_capacity) return MemoryUsage();
+    return MemoryUsage(s.size() + 1, s.capacity() + 1);
+}
+
+// Red-black tree node: colour, parent, left and right ahead of the value.
+const size_t MAP_NODE_HEADER = 4 * sizeof(void*);
+// Hash node: next pointer ahead of the value, cached hash after it.
+const size_t HASH_NODE_HEADER = 2 * sizeof(void*);
+
+// Resident set size and its peak from /proc/self/status; false if unknown.
+bool process_memory(size_t& rss, size_t& peak);
+
+#endif
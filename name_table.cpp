@@ -0,0 +1,122 @@
+#include "name_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+// Tries per bucket before the build starts over with another seed.
+const uint32_t MAX_DISPLACEMENT = 1 << 16;
+
+uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t hash_name(const char* data, size_t length, uint64_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (size_t i = 0; i < length; i++) {
+        h = (h ^ (unsigned char)data[i]) * 0x100000001b3ULL;
+    }
+    return mix(h);
+}
+
+// Slot of a hash under displacement d: (a + d * b) mod slots, b odd.
+size_t slot_of(uint64_t h, uint32_t d, size_t slot_count) {
+    uint64_t a = h >> 32;
+    uint64_t b = mix(h) | 1;
+    return (a + d * b) % slot_count;
+}
+
+}  // namespace
+
+void NameTable::build(const vector<string>& names) {
+    chars.clear();
+    offsets.assign(1, 0);
+    for (const string& name : names) {
+        chars += name;
+        offsets.push_back(chars.size());
+    }
+    chars.shrink_to_fit();
+
+    vector<uint64_t> hashes(names.size());
+    for (seed = 0;; seed++) {
+        for (size_t i = 0; i < names.size(); i++) {
+            hashes[i] = hash_name(names[i].data(), names[i].size(), seed);
+        }
+        if (place(hashes)) return;
+    }
+}
+
+// Assigns displacements bucket by bucket, largest buckets first, and fails
+// if some bucket finds no displacement that lands all its names on free slots.
+bool NameTable::place(const vector<uint64_t>& hashes) {
+    size_t n = hashes.size();
+    size_t bucket_count = n / 3 + 1;
+    size_t slot_count = n + n / 4 + 1;
+    displacements.assign(bucket_count, 0);
+    slots.assign(slot_count, -1);
+
+    // Names grouped by bucket: bucket b is members[starts[b], starts[b + 1])
+    vector<uint32_t> starts(bucket_count + 1, 0);
+    for (size_t i = 0; i < n; i++) {
+        starts[hashes[i] % bucket_count + 1]++;
+    }
+    for (size_t b = 0; b < bucket_count; b++) {
+        starts[b + 1] += starts[b];
+    }
+    vector<int> members(n);
+    vector<uint32_t> next_member(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < n; i++) {
+        members[next_member[hashes[i] % bucket_count]++] = i;
+    }
+    vector<int> order(bucket_count);
+    for (size_t b = 0; b < bucket_count; b++) {
+        order[b] = b;
+    }
+    sort(order.begin(), order.end(),
+         [&starts](int a, int b) { return starts[a + 1] - starts[a] > starts[b + 1] - starts[b]; });
+
+    vector<size_t> taken;
+    for (int b : order) {
+        if (starts[b] == starts[b + 1]) break;
+        uint32_t d = 0;
+        for (; d < MAX_DISPLACEMENT; d++) {
+            taken.clear();
+            bool fits = true;
+            for (uint32_t m = starts[b]; m < starts[b + 1]; m++) {
+                size_t slot = slot_of(hashes[members[m]], d, slot_count);
+                if (slots[slot] >= 0 || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+                    fits = false;
+                    break;
+                }
+                taken.push_back(slot);
+            }
+            if (fits) break;
+        }
+        if (d == MAX_DISPLACEMENT) return false;
+        displacements[b] = d;
+        for (uint32_t m = starts[b]; m < starts[b + 1]; m++) {
+            slots[taken[m - starts[b]]] = members[m];
+        }
+    }
+    return true;
+}
+
+int NameTable::find(const string& name) const {
+    if (slots.empty()) return -1;
+    uint64_t h = hash_name(name.data(), name.size(), seed);
+    int id = slots[slot_of(h, displacements[h % displacements.size()], slots.size())];
+    if (id < 0) return -1;
+    size_t length = offsets[id + 1] - offsets[id];
+    if (length != name.size() || memcmp(chars.data() + offsets[id], name.data(), length) != 0) {
+        return -1;
+    }
+    return id;
+}
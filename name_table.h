@@ -0,0 +1,45 @@
+#ifndef NAME_TABLE_H
+#define NAME_TABLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "memory_stats.h"
+
+// Immutable name -> dense id table, built once when registration closes.
+// Names are stored back to back in one buffer; lookups go through a
+// hash-and-displace perfect hash: the name's bucket holds a displacement
+// that sends every name of the bucket to its own slot, so a lookup is two
+// hashes, two array reads and one comparison, whether or not the name exists.
+class NameTable {
+public:
+    NameTable() : seed(0) {}
+
+    // Names must be distinct; id i is names[i].
+    void build(const std::vector<std::string>& names);
+
+    // Id of name, or -1.
+    int find(const std::string& name) const;
+
+    int size() const { return (int)offsets.size() - 1; }
+
+    MemoryUsage memory() const {
+        MemoryUsage usage = string_usage(chars);
+        usage += vector_usage(offsets);
+        usage += vector_usage(displacements);
+        usage += vector_usage(slots);
+        return usage;
+    }
+
+private:
+    std::string chars;               // every name, in id order
+    std::vector<uint32_t> offsets;   // name i is chars[offsets[i], offsets[i + 1])
+    std::vector<uint32_t> displacements; // per bucket
+    std::vector<int32_t> slots;      // id per slot, -1 if empty
+    uint64_t seed;
+
+    bool place(const std::vector<uint64_t>& hashes);
+};
+
+#endif
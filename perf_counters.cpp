@@ -0,0 +1,73 @@
+#include "perf_counters.h"
+
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+int open_counter(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+uint64_t cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | op << 8 | result << 16;
+}
+
+}  // namespace
+
+PerfCounters::~PerfCounters() {
+    for (const Counter& counter : counters) {
+        if (counter.fd >= 0) close(counter.fd);
+    }
+}
+
+void PerfCounters::start() {
+    counters = {
+        {"cycles", open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES)},
+        {"instructions", open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS)},
+        {"dtlb_load_misses",
+         open_counter(PERF_TYPE_HW_CACHE,
+                      cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                  PERF_COUNT_HW_CACHE_RESULT_MISS))},
+        {"cache_misses", open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES)},
+        {"page_faults", open_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS)},
+    };
+    for (const Counter& counter : counters) {
+        if (counter.fd >= 0) {
+            ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop() {
+    for (const Counter& counter : counters) {
+        if (counter.fd >= 0) ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+void PerfCounters::report(ostream& out) const {
+    for (const Counter& counter : counters) {
+        uint64_t value;
+        out << "perf: " << counter.name << " ";
+        if (counter.fd >= 0 && read(counter.fd, &value, sizeof(value)) == sizeof(value)) {
+            out << value << "\n";
+        } else {
+            out << "unavailable\n";
+        }
+    }
+}
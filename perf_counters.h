@@ -0,0 +1,31 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <ostream>
+#include <vector>
+
+// Hardware counters of this process (user space only) through
+// perf_event_open: cycles, instructions, dTLB load misses and cache misses.
+// Counters the kernel or the machine does not offer are reported as such.
+class PerfCounters {
+public:
+    PerfCounters() {}
+    ~PerfCounters();
+
+    void start();
+    void stop();
+    // One "perf: name value" line per counter.
+    void report(std::ostream& out) const;
+
+private:
+    struct Counter {
+        const char* name;
+        int fd;
+    };
+    std::vector<Counter> counters;
+
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+};
+
+#endif
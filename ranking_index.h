@@ -0,0 +1,174 @@
+#ifndef RANKING_INDEX_H
+#define RANKING_INDEX_H
+
+#include <cstdint>
+#include <vector>
+
+#include "huge_pages.h"
+#include "memory_stats.h"
+
+// Order-statistics treap over team ids. Node i always belongs to team i, so
+// the index allocates nothing once it has been sized. The order comes from
+// Less(a, b) ("team a ranks above team b"), which must not change for a team
+// while it is in the index: erase it, update its key, insert it again.
+template <class Less>
+class RankingIndex {
+public:
+    explicit RankingIndex(Less less) : less(less), root(-1), seed(2463534242u) {}
+
+    // Makes room for team ids 0..n-1; never shrinks.
+    void resize(int n) {
+        while ((int)nodes.size() < n) {
+            Node node;
+            node.left = node.right = -1;
+            node.size = 1;
+            node.priority = next_priority();
+            node.linked = false;
+            nodes.push_back(node);
+        }
+    }
+
+    bool contains(int id) const { return id < (int)nodes.size() && nodes[id].linked; }
+
+    int size() const { return size_of(root); }
+
+    MemoryUsage memory() const { return vector_usage(nodes); }
+
+    void insert(int id) {
+        Node& node = nodes[id];
+        node.left = node.right = -1;
+        node.size = 1;
+        node.linked = true;
+        int left, right;
+        split(root, id, left, right);
+        root = merge(merge(left, id), right);
+    }
+
+    // Unlinks every member; the nodes stay allocated.
+    void clear() {
+        for (Node& node : nodes) node.linked = false;
+        root = -1;
+    }
+
+    void erase(int id) {
+        root = erase_from(root, id);
+        nodes[id].linked = false;
+    }
+
+    // 1-based rank of a member.
+    int rank(int id) const {
+        int before = 0;
+        int t = root;
+        while (t != id) {
+            if (less(id, t)) {
+                t = nodes[t].left;
+            } else {
+                before += size_of(nodes[t].left) + 1;
+                t = nodes[t].right;
+            }
+        }
+        return before + size_of(nodes[id].left) + 1;
+    }
+
+    // Member at 1-based rank r, or -1 if r is out of range.
+    int at(int r) const {
+        if (r < 1 || r > size()) return -1;
+        int t = root;
+        while (true) {
+            int left = size_of(nodes[t].left);
+            if (r <= left) {
+                t = nodes[t].left;
+            } else if (r == left + 1) {
+                return t;
+            } else {
+                r -= left + 1;
+                t = nodes[t].right;
+            }
+        }
+    }
+
+    // Calls f(id) for every member, best first.
+    template <class F>
+    void for_each(F f) const {
+        walk(root, f);
+    }
+
+private:
+    struct Node {
+        int left;
+        int right;
+        int size;
+        uint32_t priority;
+        bool linked;
+    };
+
+    Less less;
+    HugeVector<Node> nodes;
+    int root;
+    uint32_t seed;
+
+    uint32_t next_priority() {
+        // xorshift32; any well-spread sequence keeps the treap balanced.
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    int size_of(int t) const { return t < 0 ? 0 : nodes[t].size; }
+
+    // In order without a heap-allocated stack: recursion goes left only, as
+    // deep as the treap, and right subtrees are walked in the loop.
+    template <class F>
+    void walk(int t, F& f) const {
+        for (; t >= 0; t = nodes[t].right) {
+            walk(nodes[t].left, f);
+            f(t);
+        }
+    }
+
+    void update(int t) { nodes[t].size = size_of(nodes[t].left) + size_of(nodes[t].right) + 1; }
+
+    // Splits t into the members ranking above id and the rest.
+    void split(int t, int id, int& left, int& right) {
+        if (t < 0) {
+            left = right = -1;
+        } else if (less(t, id)) {
+            split(nodes[t].right, id, nodes[t].right, right);
+            left = t;
+            update(t);
+        } else {
+            split(nodes[t].left, id, left, nodes[t].left);
+            right = t;
+            update(t);
+        }
+    }
+
+    int merge(int left, int right) {
+        if (left < 0) return right;
+        if (right < 0) return left;
+        if (nodes[left].priority > nodes[right].priority) {
+            nodes[left].right = merge(nodes[left].right, right);
+            update(left);
+            return left;
+        }
+        nodes[right].left = merge(left, nodes[right].left);
+        update(right);
+        return right;
+    }
+
+    int erase_from(int t, int id) {
+        if (t == id) {
+            return merge(nodes[t].left, nodes[t].right);
+        }
+        if (less(id, t)) {
+            nodes[t].left = erase_from(nodes[t].left, id);
+        } else {
+            nodes[t].right = erase_from(nodes[t].right, id);
+        }
+        update(t);
+        return t;
+    }
+};
+
+#endif
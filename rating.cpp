@@ -0,0 +1,92 @@
+#include "rating.h"
+
+#include <algorithm>
+#include <cmath>
+#include <system_error>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// sum over k of weight[k] * q[k] / (qi + q[k]) for every i in [begin, end).
+void seed_kernel(const vector<double>& q, const vector<double>& weight, vector<double>& sums,
+                 size_t begin, size_t end) {
+    const double* qs = q.data();
+    const double* ws = weight.data();
+    size_t count = q.size();
+    for (size_t i = begin; i < end; i++) {
+        double qi = qs[i];
+        double sum = 0;
+#pragma omp simd reduction(+ : sum)
+        for (size_t k = 0; k < count; k++) {
+            sum += ws[k] * qs[k] / (qi + qs[k]);
+        }
+        sums[i] = sum;
+    }
+}
+
+}  // namespace
+
+vector<double> expected_ranks(const vector<int>& ratings, int threads) {
+    vector<int> values(ratings);
+    sort(values.begin(), values.end());
+    values.erase(unique(values.begin(), values.end()), values.end());
+    if (values.empty()) {
+        return vector<double>();
+    }
+
+    // q = 10^((r - max) / 400) keeps every term in (0, 1].
+    vector<double> q(values.size());
+    vector<double> weight(values.size(), 0);
+    for (size_t k = 0; k < values.size(); k++) {
+        q[k] = pow(10.0, (values[k] - values.back()) / 400.0);
+    }
+    for (int r : ratings) {
+        weight[lower_bound(values.begin(), values.end(), r) - values.begin()] += 1;
+    }
+
+    if (threads <= 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    threads = max(1, min<int>(threads, values.size() / 64 + 1));
+    vector<double> sums(values.size());
+    vector<thread> workers;
+    workers.reserve(threads - 1);
+    size_t chunk = (values.size() + threads - 1) / threads;
+    for (int t = 1; t < threads; t++) {
+        size_t begin = t * chunk;
+        size_t end = min(values.size(), begin + chunk);
+        if (begin >= end) continue;
+        try {
+            workers.emplace_back(seed_kernel, cref(q), cref(weight), ref(sums), begin, end);
+        } catch (const system_error&) {
+            // Out of threads: the caller computes this chunk itself
+            seed_kernel(q, weight, sums, begin, end);
+        }
+    }
+    seed_kernel(q, weight, sums, 0, min(chunk, values.size()));
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // The sum includes the team itself with weight 1/2.
+    vector<double> expected(ratings.size());
+    for (size_t i = 0; i < ratings.size(); i++) {
+        size_t k = lower_bound(values.begin(), values.end(), ratings[i]) - values.begin();
+        expected[i] = 0.5 + sums[k];
+    }
+    return expected;
+}
+
+vector<int> rating_deltas(const vector<int>& ratings, const vector<double>& ranks, int threads) {
+    vector<int> deltas(ratings.size(), 0);
+    if (ratings.size() < 2) {
+        return deltas;
+    }
+    vector<double> expected = expected_ranks(ratings, threads);
+    for (size_t i = 0; i < ratings.size(); i++) {
+        deltas[i] = (int)lround(RATING_K * (expected[i] - ranks[i]) / (ratings.size() - 1));
+    }
+    return deltas;
+}
@@ -0,0 +1,24 @@
+#ifndef RATING_H
+#define RATING_H
+
+#include <vector>
+
+// Elo-style post-contest rating update.
+//
+// The expected rank of team i is 1 + sum over j != i of P(j beats i), with
+// P(j beats i) = 1 / (1 + 10^((r_i - r_j) / 400)). Teams with equal ratings
+// have equal expected ranks, so the pairwise sum only runs over distinct
+// ratings (weighted by how many teams hold each one); that V x V kernel is
+// vectorized and split across threads. With integer ratings V is bounded by
+// the rating spread, so 10^5 teams cost about as much as 10^4.
+
+// Expected rank of every team; threads <= 0 uses every hardware thread.
+std::vector<double> expected_ranks(const std::vector<int>& ratings, int threads);
+
+// Rating change for final ranks (1 = best; tied teams share their average):
+// round(RATING_K * (expected rank - actual rank) / (N - 1)).
+const double RATING_K = 400;
+std::vector<int> rating_deltas(const std::vector<int>& ratings, const std::vector<double>& ranks,
+                               int threads);
+
+#endif
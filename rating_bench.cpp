@@ -0,0 +1,57 @@
+// Times the expected-rank computation of rating.cpp against the plain
+// pairwise sum.
+//
+//   rating_bench [N...]        defaults to 10000 and 100000 teams
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "rating.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    vector<int> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back(atoi(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes = {10000, 100000};
+    }
+
+    mt19937 rng(2024);
+    normal_distribution<double> spread(1500, 350);
+    for (int n : sizes) {
+        vector<int> ratings(n);
+        for (int& r : ratings) {
+            r = (int)lround(spread(rng));
+        }
+
+        auto begin = chrono::steady_clock::now();
+        vector<double> fast = expected_ranks(ratings, 0);
+        double fast_s = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+        // The quadratic baseline on a sample of teams, scaled up to all N.
+        int sample = min(n, 500);
+        begin = chrono::steady_clock::now();
+        double max_error = 0;
+        for (int i = 0; i < sample; i++) {
+            double expected = 1;
+            for (int j = 0; j < n; j++) {
+                if (i != j) expected += 1 / (1 + pow(10.0, (ratings[i] - ratings[j]) / 400.0));
+            }
+            max_error = max(max_error, fabs(expected - fast[i]));
+        }
+        double naive_s = chrono::duration<double>(chrono::steady_clock::now() - begin).count()
+                         * n / sample;
+
+        cout << "N=" << n << " kernel " << fast_s * 1e3 << " ms, pairwise (extrapolated) "
+             << naive_s * 1e3 << " ms, speedup " << naive_s / fast_s
+             << "x, max |difference| " << max_error << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,610 @@
+#include "scoreboard_server.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const size_t MAX_HEADER_BYTES = 16 * 1024;
+const int MAX_EVENTS = 64;
+const int MAX_IOVECS = 16;
+// Queued event bytes beyond which a subscriber is dropped to a resync.
+const size_t MAX_STREAM_BACKLOG = 4 * 1024 * 1024;
+
+bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+string lowercase(string s) {
+    transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return tolower(c); });
+    return s;
+}
+
+string gzip(const string& data) {
+#ifdef HAVE_ZLIB
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // 15 + 16 selects the gzip wrapper instead of raw zlib.
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return "";
+    }
+    string out(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = data.size();
+    zs.next_out = (Bytef*)&out[0];
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END ? out : "";
+#else
+    (void)data;
+    return "";
+#endif
+}
+
+// The line of one team in a rendered board, including its newline; empty for
+// a disqualified team.
+string team_row(const ScoreboardSnapshot& snapshot, int team) {
+    size_t begin = snapshot.row_offsets[team];
+    if (begin >= snapshot.text.size()) return "";
+    return snapshot.text.substr(begin, snapshot.text.find('\n', begin) + 1 - begin);
+}
+
+// What a subscriber of a team is sent: its row, or a notice once it is gone.
+string subscriber_frame(const ScoreboardSnapshot& snapshot, int team, const string& name) {
+    string row = team_row(snapshot, team);
+    return row.empty() ? "[Info]" + name + " has been disqualified.\n" : row;
+}
+
+const string& subscribed_name(const vector<int>& teams, const vector<string>& names, int team) {
+    return names[find(teams.begin(), teams.end(), team) - teams.begin()];
+}
+
+void append_response(string& out, const string& status, const string& etag,
+                     const string& content_type, const string& body,
+                     bool gzipped, bool head_only, bool keep_alive) {
+    out += "HTTP/1.1 " + status + "\r\n";
+    if (!etag.empty()) {
+        out += "ETag: " + etag + "\r\n";
+        out += "Cache-Control: no-cache\r\n";
+        out += "Vary: Accept-Encoding\r\n";
+    }
+    if (!content_type.empty()) {
+        out += "Content-Type: " + content_type + "\r\n";
+    }
+    if (gzipped) {
+        out += "Content-Encoding: gzip\r\n";
+    }
+    out += "Content-Length: " + to_string(body.size()) + "\r\n";
+    out += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    out += "\r\n";
+    if (!head_only) {
+        out += body;
+    }
+}
+
+}  // namespace
+
+ScoreboardServer::ScoreboardServer(int port)
+    : port(port), listen_fd(-1), epoll_fd(-1), wake_fd(-1) {}
+
+ScoreboardServer::~ScoreboardServer() {
+    if (worker.joinable()) {
+        worker.detach();
+    }
+}
+
+bool ScoreboardServer::start() {
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        return false;
+    }
+    int yes = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0 ||
+        !set_nonblocking(listen_fd)) {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    epoll_fd = epoll_create1(0);
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+    ev.data.fd = wake_fd;
+    if (wake_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    worker = thread(&ScoreboardServer::run, this);
+    return true;
+}
+
+void ScoreboardServer::publish(shared_ptr<const ScoreboardSnapshot> snapshot) {
+    {
+        lock_guard<mutex> lock(latest_mutex);
+        latest = snapshot;
+        pending.push_back(move(snapshot));
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void ScoreboardServer::join() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void ScoreboardServer::run() {
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) {
+                accept_clients();
+                continue;
+            }
+            if (fd == wake_fd) {
+                uint64_t count;
+                ssize_t ignored = read(wake_fd, &count, sizeof(count));
+                (void)ignored;
+                drain_published();
+                continue;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close_connection(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                handle_readable(fd);
+            }
+            if ((events[i].events & EPOLLOUT) && connections.count(fd)) {
+                handle_writable(fd);
+            }
+        }
+    }
+}
+
+void ScoreboardServer::accept_clients() {
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        if (!set_nonblocking(fd)) {
+            close(fd);
+            continue;
+        }
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        connections[fd] = Connection();
+    }
+}
+
+void ScoreboardServer::close_connection(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    auto it = connections.find(fd);
+    if (it != connections.end()) {
+        for (int team : it->second.teams) {
+            vector<int>& fds = team_subscribers[team];
+            fds.erase(find(fds.begin(), fds.end(), fd));
+        }
+        connections.erase(it);
+    }
+    streams.erase(fd);
+}
+
+void ScoreboardServer::refresh_bodies() {
+    shared_ptr<const ScoreboardSnapshot> snapshot;
+    {
+        lock_guard<mutex> lock(latest_mutex);
+        snapshot = latest;
+    }
+    if (!snapshot || (bodies.snapshot && bodies.snapshot->version == snapshot->version)) {
+        return;
+    }
+    bodies.snapshot = snapshot;
+    bodies.text_gz = gzip(snapshot->text);
+    bodies.json_gz = gzip(snapshot->json);
+    bodies.snapshot_event = make_shared<const string>(
+        "id: " + to_string(snapshot->version) + "\nevent: snapshot\ndata: " + snapshot->json + "\n\n");
+}
+
+// Fans every newly published delta out to the event-stream subscribers. The
+// frame is allocated once and only referenced from each subscriber's queue.
+void ScoreboardServer::drain_published() {
+    vector<shared_ptr<const ScoreboardSnapshot>> batch;
+    {
+        lock_guard<mutex> lock(latest_mutex);
+        batch.swap(pending);
+    }
+    refresh_bodies();
+    vector<int> touched;
+    for (auto& snapshot : batch) {
+        notify_teams(*snapshot);
+        for (int team : snapshot->changed_teams) {
+            if (team < (int)team_subscribers.size()) {
+                touched.insert(touched.end(), team_subscribers[team].begin(), team_subscribers[team].end());
+            }
+        }
+    }
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+    for (int fd : touched) {
+        if (connections.count(fd)) {
+            flush_output(fd, connections[fd]);
+        }
+    }
+    if (streams.empty()) {
+        return;
+    }
+
+    for (auto& snapshot : batch) {
+        Frame frame;
+        if (!snapshot->delta.empty()) {
+            frame = make_shared<const string>("id: " + to_string(snapshot->version)
+                                              + "\nevent: delta\ndata: " + snapshot->delta + "\n\n");
+        }
+        for (int fd : streams) {
+            Connection& conn = connections[fd];
+            if (conn.stream_version >= snapshot->version) {
+                continue;
+            }
+            if (!frame || conn.stream_version != snapshot->version - 1 ||
+                conn.frame_bytes > MAX_STREAM_BACKLOG) {
+                resync(conn);
+            } else {
+                conn.frames.push_back(frame);
+                conn.frame_bytes += frame->size();
+                conn.stream_version = snapshot->version;
+            }
+        }
+    }
+
+    vector<int> fds(streams.begin(), streams.end());
+    for (int fd : fds) {
+        flush_output(fd, connections[fd]);
+    }
+}
+
+// Queues the new row of every changed team for that team's subscribers; one
+// frame per changed team is shared by all of them.
+void ScoreboardServer::notify_teams(const ScoreboardSnapshot& snapshot) {
+    for (int team : snapshot.changed_teams) {
+        if (team >= (int)team_subscribers.size() || team_subscribers[team].empty()) {
+            continue;
+        }
+        const Connection& first = connections[team_subscribers[team][0]];
+        const string& name = subscribed_name(first.teams, first.team_names, team);
+        Frame frame = make_shared<const string>(subscriber_frame(snapshot, team, name));
+        for (int fd : team_subscribers[team]) {
+            Connection& conn = connections[fd];
+            if (conn.frame_bytes > MAX_STREAM_BACKLOG) {
+                resync_subscriber(conn);
+                continue;
+            }
+            conn.frames.push_back(frame);
+            conn.frame_bytes += frame->size();
+        }
+    }
+}
+
+// Drops a lagging subscriber's backlog in favour of the latest row of each of
+// its teams.
+void ScoreboardServer::resync_subscriber(Connection& conn) {
+    while (conn.frames.size() > (conn.frame_pos > 0 ? 1u : 0u)) {
+        conn.frame_bytes -= conn.frames.back()->size();
+        conn.frames.pop_back();
+    }
+    for (size_t i = 0; i < conn.teams.size(); i++) {
+        Frame frame = make_shared<const string>(
+            subscriber_frame(*bodies.snapshot, conn.teams[i], conn.team_names[i]));
+        conn.frames.push_back(frame);
+        conn.frame_bytes += frame->size();
+    }
+}
+
+// Handles the line protocol: each "SUBSCRIBE team" line adds one team.
+void ScoreboardServer::handle_subscribe(int fd, Connection& conn) {
+    // Replies share the frame queue with pending rows so they stay in order.
+    auto reply = [&conn](const string& text) {
+        conn.frames.push_back(make_shared<const string>(text));
+        conn.frame_bytes += text.size();
+    };
+    size_t end;
+    while ((end = conn.in.find('\n')) != string::npos) {
+        string line = conn.in.substr(0, end);
+        conn.in.erase(0, end + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        istringstream iss(line);
+        string command, team_name;
+        iss >> command >> team_name;
+        if (command != "SUBSCRIBE") {
+            reply("[Error]Subscribe failed: unknown command.\n");
+            continue;
+        }
+
+        refresh_bodies();
+        auto it = bodies.snapshot ? bodies.snapshot->team_ids->find(team_name)
+                                  : unordered_map<string, int>::const_iterator();
+        if (!bodies.snapshot || it == bodies.snapshot->team_ids->end()) {
+            reply("[Error]Subscribe failed: cannot find the team.\n");
+            continue;
+        }
+        int team = it->second;
+        string row = team_row(*bodies.snapshot, team);
+        if (row.empty()) {
+            reply("[Error]Subscribe failed: team has been disqualified.\n");
+            continue;
+        }
+        if (find(conn.teams.begin(), conn.teams.end(), team) == conn.teams.end()) {
+            conn.teams.push_back(team);
+            conn.team_names.push_back(team_name);
+            if (team >= (int)team_subscribers.size()) {
+                team_subscribers.resize(team + 1);
+            }
+            team_subscribers[team].push_back(fd);
+        }
+        reply("[Info]Subscribe successfully.\n");
+        reply(row);
+    }
+    if (conn.in.size() > MAX_HEADER_BYTES) {
+        conn.close_after_write = true;
+    }
+}
+
+// Replaces a subscriber's backlog with the latest full board. A frame that is
+// already partially sent has to be finished to keep the stream well-formed.
+void ScoreboardServer::resync(Connection& conn) {
+    while (conn.frames.size() > (conn.frame_pos > 0 ? 1u : 0u)) {
+        conn.frame_bytes -= conn.frames.back()->size();
+        conn.frames.pop_back();
+    }
+    conn.frames.push_back(bodies.snapshot_event);
+    conn.frame_bytes += bodies.snapshot_event->size();
+    conn.stream_version = bodies.snapshot->version;
+}
+
+void ScoreboardServer::handle_readable(int fd) {
+    Connection& conn = connections[fd];
+    char buf[4096];
+    while (true) {
+        ssize_t got = recv(fd, buf, sizeof(buf), 0);
+        if (got > 0) {
+            conn.in.append(buf, got);
+            continue;
+        }
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        close_connection(fd);
+        return;
+    }
+
+    if (conn.subscriber || conn.in.compare(0, 10, "SUBSCRIBE ") == 0) {
+        conn.subscriber = true;
+        handle_subscribe(fd, conn);
+        flush_output(fd, conn);
+        return;
+    }
+
+    // Answer every complete (possibly pipelined) request in the buffer. An
+    // event stream owns the rest of the connection, so its input is dropped.
+    if (conn.streaming) {
+        conn.in.clear();
+    }
+    while (!conn.close_after_write && !conn.streaming) {
+        size_t end = conn.in.find("\r\n\r\n");
+        if (end == string::npos) {
+            if (conn.in.size() > MAX_HEADER_BYTES) {
+                append_response(conn.out, "431 Request Header Fields Too Large", "", "", "",
+                                false, false, false);
+                conn.close_after_write = true;
+            }
+            break;
+        }
+        string head = conn.in.substr(0, end);
+        conn.in.erase(0, end + 4);
+        if (!handle_request(fd, conn, head)) {
+            conn.close_after_write = true;
+        }
+    }
+    flush_output(fd, conn);
+}
+
+void ScoreboardServer::handle_writable(int fd) {
+    flush_output(fd, connections[fd]);
+}
+
+void ScoreboardServer::flush_output(int fd, Connection& conn) {
+    while (true) {
+        // sendmsg reports 0 bytes for an empty frame, which would never be
+        // popped below
+        while (!conn.frames.empty() && conn.frame_pos == 0 && conn.frames.front()->empty()) {
+            conn.frames.pop_front();
+        }
+        iovec iov[MAX_IOVECS];
+        int count = 0;
+        if (conn.out_pos < conn.out.size()) {
+            iov[count].iov_base = (void*)(conn.out.data() + conn.out_pos);
+            iov[count].iov_len = conn.out.size() - conn.out_pos;
+            count++;
+        }
+        size_t skip = conn.frame_pos;
+        for (size_t i = 0; i < conn.frames.size() && count < MAX_IOVECS; i++) {
+            iov[count].iov_base = (void*)(conn.frames[i]->data() + skip);
+            iov[count].iov_len = conn.frames[i]->size() - skip;
+            count++;
+            skip = 0;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close_connection(fd);
+            return;
+        }
+
+        size_t left = sent;
+        size_t from_out = min(left, conn.out.size() - conn.out_pos);
+        conn.out_pos += from_out;
+        left -= from_out;
+        while (left > 0) {
+            size_t rest = conn.frames.front()->size() - conn.frame_pos;
+            if (left < rest) {
+                conn.frame_pos += left;
+                break;
+            }
+            left -= rest;
+            conn.frame_bytes -= conn.frames.front()->size();
+            conn.frames.pop_front();
+            conn.frame_pos = 0;
+        }
+    }
+
+    if (conn.out_pos == conn.out.size()) {
+        conn.out.clear();
+        conn.out_pos = 0;
+    }
+    bool pending_output = !conn.out.empty() || !conn.frames.empty();
+    if (!pending_output && conn.close_after_write) {
+        close_connection(fd);
+        return;
+    }
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = pending_output ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+// Returns whether the connection stays open after this response.
+bool ScoreboardServer::handle_request(int fd, Connection& conn, const string& head) {
+    istringstream iss(head);
+    string method, target, version, line;
+    iss >> method >> target >> version;
+    getline(iss, line);
+
+    bool keep_alive = version == "HTTP/1.1";
+    bool accepts_gzip = false;
+    string if_none_match;
+    while (getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == string::npos) continue;
+        string key = lowercase(line.substr(0, colon));
+        size_t start = line.find_first_not_of(' ', colon + 1);
+        string value = start == string::npos ? "" : line.substr(start);
+        if (key == "connection") {
+            string v = lowercase(value);
+            if (v == "close") keep_alive = false;
+            if (v == "keep-alive") keep_alive = true;
+        } else if (key == "accept-encoding") {
+            accepts_gzip = lowercase(value).find("gzip") != string::npos;
+        } else if (key == "if-none-match") {
+            if_none_match = value;
+        }
+    }
+
+    string path = target.substr(0, target.find('?'));
+    bool head_only = method == "HEAD";
+    if (method != "GET" && !head_only) {
+        append_response(conn.out, "405 Method Not Allowed", "", "", "", false, false, false);
+        return false;
+    }
+    if (path == "/events" && !head_only) {
+        conn.out += "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                    "Cache-Control: no-cache\r\nConnection: keep-alive\r\n\r\n";
+        conn.streaming = true;
+        refresh_bodies();
+        if (bodies.snapshot) {
+            resync(conn);
+        }
+        streams.insert(fd);
+        return true;
+    }
+    bool want_json = path == "/scoreboard.json";
+    if (!want_json && path != "/" && path != "/scoreboard") {
+        append_response(conn.out, "404 Not Found", "", "", "", false, head_only, keep_alive);
+        return keep_alive;
+    }
+
+    refresh_bodies();
+    if (!bodies.snapshot) {
+        append_response(conn.out, "503 Service Unavailable", "", "", "", false, head_only, keep_alive);
+        return keep_alive;
+    }
+
+    // Weak validator: the gzip and identity bodies of one flush are equivalent.
+    string etag = "W/\"" + to_string(bodies.snapshot->version) + "\"";
+    if (if_none_match == etag || if_none_match == "*") {
+        append_response(conn.out, "304 Not Modified", etag, "", "", false, true, keep_alive);
+        return keep_alive;
+    }
+
+    const string& plain = want_json ? bodies.snapshot->json : bodies.snapshot->text;
+    const string& packed = want_json ? bodies.json_gz : bodies.text_gz;
+    bool gzipped = accepts_gzip && !packed.empty();
+    append_response(conn.out, "200 OK", etag,
+                    want_json ? "application/json" : "text/plain; charset=utf-8",
+                    gzipped ? packed : plain, gzipped, head_only, keep_alive);
+    return keep_alive;
+}
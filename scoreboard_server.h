@@ -0,0 +1,125 @@
+#ifndef SCOREBOARD_SERVER_H
+#define SCOREBOARD_SERVER_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Scoreboard as of one flush. Rendered once by the engine and then only read
+// by the server thread, so it is shared without copying.
+struct ScoreboardSnapshot {
+    long long version;
+    std::string text;
+    std::string json;
+    std::string delta; // JSON changes since version - 1; empty for the first board
+    std::vector<size_t> row_offsets; // team id -> start of its line in text;
+                                     // text.size() for a disqualified team
+    std::vector<int> changed_teams;  // ids whose row changed, appeared or went
+                                     // away since version - 1
+    std::shared_ptr<const std::unordered_map<std::string, int>> team_ids;
+};
+
+// Minimal HTTP/1.1 server (epoll, keep-alive) publishing the flushed board.
+//
+//   GET /scoreboard        text board, same layout as the SCROLL output
+//   GET /scoreboard.json   the same board as JSON
+//   GET /events            server-sent events: one snapshot, then one delta
+//                          per flush (changed rows, rank moves and the names
+//                          of teams disqualified since)
+//
+// A connection that starts with a plain "SUBSCRIBE team" line instead of an
+// HTTP request gets that team's board row now and again whenever its rank or
+// cells change; further SUBSCRIBE lines add more teams. A disqualified team
+// has no row: subscribing to it fails, and its subscribers are sent a
+// "[Info]team has been disqualified." line instead of the row. Subscribers are
+// indexed by team id, so a flush costs time proportional to the teams that
+// changed rather than to subscribers times teams.
+//
+// The ETag is the flush version, so a poll with a matching If-None-Match is
+// answered with 304 without touching the body. Bodies are gzip-compressed
+// once per version (when built with zlib) and served to clients that accept
+// it.
+//
+// Every event frame is built once and shared by all subscribers; a subscriber
+// that falls too far behind loses its backlog and is resynced with a fresh
+// snapshot instead.
+class ScoreboardServer {
+public:
+    explicit ScoreboardServer(int port);
+    ~ScoreboardServer();
+
+    // Binds the port and starts the event loop thread; false on failure.
+    bool start();
+    // Called by the engine after every flush; cheap, never blocks on clients.
+    void publish(std::shared_ptr<const ScoreboardSnapshot> snapshot);
+    // Serves until the process is interrupted.
+    void join();
+
+private:
+    typedef std::shared_ptr<const std::string> Frame;
+
+    struct Connection {
+        std::string in;
+        std::string out;
+        size_t out_pos;
+        bool close_after_write;
+        // Event-stream state; frames are queued after out has been sent.
+        bool streaming;
+        long long stream_version;
+        std::deque<Frame> frames;
+        size_t frame_pos;
+        size_t frame_bytes;
+        // Team ids of a SUBSCRIBE connection, and their names in the same order.
+        bool subscriber;
+        std::vector<int> teams;
+        std::vector<std::string> team_names;
+
+        Connection() : out_pos(0), close_after_write(false), streaming(false),
+                       stream_version(-1), frame_pos(0), frame_bytes(0), subscriber(false) {}
+    };
+
+    // Server-thread view of the latest snapshot plus its compressed bodies.
+    struct Bodies {
+        std::shared_ptr<const ScoreboardSnapshot> snapshot;
+        std::string text_gz;
+        std::string json_gz;
+        Frame snapshot_event;
+    };
+
+    int port;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    std::thread worker;
+
+    std::mutex latest_mutex;
+    std::shared_ptr<const ScoreboardSnapshot> latest;
+    std::vector<std::shared_ptr<const ScoreboardSnapshot>> pending;
+
+    // Owned by the server thread only.
+    Bodies bodies;
+    std::unordered_map<int, Connection> connections;
+    std::unordered_set<int> streams;
+    std::vector<std::vector<int>> team_subscribers; // team id -> fds
+
+    void run();
+    void accept_clients();
+    void handle_readable(int fd);
+    void handle_writable(int fd);
+    void close_connection(int fd);
+    void refresh_bodies();
+    void drain_published();
+    void resync(Connection& conn);
+    void notify_teams(const ScoreboardSnapshot& snapshot);
+    void resync_subscriber(Connection& conn);
+    void handle_subscribe(int fd, Connection& conn);
+    bool handle_request(int fd, Connection& conn, const std::string& head);
+    void flush_output(int fd, Connection& conn);
+};
+
+#endif
@@ -0,0 +1,192 @@
+// Season leaderboard over the submission logs of several contests, in the
+// order given (the files written by `code --export FILE`).
+//
+//   season [--points] FILE...
+//
+// By default teams are ranked by total solved problems, then total penalty.
+// With --points each contest awards points by its final rank instead, and
+// teams are ranked by total points (ties broken by solved, then penalty).
+// Teams are matched across contests by name.
+//
+// Each contest contributes the engine's final standings stored in its log, so
+// jury penalties count and hidden or disqualified teams take no part. Logs
+// from before the standings were exported are replayed from their
+// submissions instead.
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ranking_index.h"
+#include "submission_log.h"
+
+using namespace std;
+
+struct SeasonTeam {
+    string name;
+    int contests;
+    long long points;
+    long long solved;
+    long long penalty;
+
+    SeasonTeam() : contests(0), points(0), solved(0), penalty(0) {}
+};
+
+struct SeasonLess {
+    const vector<SeasonTeam>* teams;
+    bool by_points;
+
+    bool operator()(int a, int b) const {
+        const SeasonTeam& t1 = (*teams)[a];
+        const SeasonTeam& t2 = (*teams)[b];
+        if (by_points && t1.points != t2.points) return t1.points > t2.points;
+        if (t1.solved != t2.solved) return t1.solved > t2.solved;
+        if (t1.penalty != t2.penalty) return t1.penalty < t2.penalty;
+        return t1.name < t2.name;
+    }
+};
+
+// Points for a final contest rank: a fixed table for the top 20, then one
+// point less per rank down to zero.
+int rank_points(int rank) {
+    static const int TABLE[] = {100, 80, 60, 50, 45, 40, 36, 32, 29, 26,
+                                24,  22, 20, 18, 16, 15, 14, 13, 12, 11};
+    if (rank <= 20) return TABLE[rank - 1];
+    return max(0, 31 - rank);
+}
+
+// Aggregate standings. Adding a contest touches only the teams that took
+// part in it: each is taken out of the ordered index, updated and put back.
+class SeasonLeaderboard {
+public:
+    explicit SeasonLeaderboard(bool by_points) : index(SeasonLess{&teams, by_points}) {}
+
+    void add_contest(const SubmissionColumns& contest) {
+        vector<FinalStanding> standings =
+            contest.standings.empty() ? replay(contest) : contest.standings;
+        for (size_t team = 0; team < standings.size(); team++) {
+            const FinalStanding& standing = standings[team];
+            if (standing.rank == 0) continue;
+            int id = team_id(contest.team_names[team]);
+            if (index.contains(id)) {
+                index.erase(id);
+            }
+            SeasonTeam& total = teams[id];
+            total.contests++;
+            total.points += rank_points(standing.rank);
+            total.solved += standing.solved;
+            total.penalty += standing.penalty;
+            index.insert(id);
+        }
+    }
+
+    void print(ostream& out) const {
+        int rank = 0;
+        index.for_each([&](int id) {
+            const SeasonTeam& team = teams[id];
+            out << ++rank << " " << team.name << " " << team.contests << " " << team.points << " "
+                << team.solved << " " << team.penalty << "\n";
+        });
+    }
+
+private:
+    // Standings rebuilt from the submissions alone, with the engine's
+    // tie-breaks but without jury penalties or listing changes.
+    static vector<FinalStanding> replay(const SubmissionColumns& contest) {
+        size_t n = contest.team_names.size();
+        vector<ContestResult> results(n);
+        vector<bool> solved_problem(n * contest.problem_count, false);
+        vector<int> wrong(n * contest.problem_count, 0);
+        for (size_t i = 0; i < contest.time.size(); i++) {
+            size_t team = contest.team[i];
+            size_t cell = team * contest.problem_count + contest.problem[i];
+            if (solved_problem[cell]) continue;
+            if (contest.status[i] == ACCEPTED) {
+                solved_problem[cell] = true;
+                results[team].solved++;
+                results[team].penalty += contest.time[i] + 20 * wrong[cell];
+                results[team].solve_times.push_back(contest.time[i]);
+            } else {
+                wrong[cell]++;
+            }
+        }
+
+        vector<int> order(n);
+        for (size_t i = 0; i < n; i++) {
+            order[i] = i;
+            sort(results[i].solve_times.rbegin(), results[i].solve_times.rend());
+        }
+        sort(order.begin(), order.end(), [&](int a, int b) {
+            if (results[a].solved != results[b].solved) return results[a].solved > results[b].solved;
+            if (results[a].penalty != results[b].penalty) return results[a].penalty < results[b].penalty;
+            if (results[a].solve_times != results[b].solve_times) {
+                return results[a].solve_times < results[b].solve_times;
+            }
+            return contest.team_names[a] < contest.team_names[b];
+        });
+
+        vector<FinalStanding> standings(n);
+        for (size_t r = 0; r < n; r++) {
+            FinalStanding& standing = standings[order[r]];
+            standing.rank = r + 1;
+            standing.solved = results[order[r]].solved;
+            standing.penalty = results[order[r]].penalty;
+        }
+        return standings;
+    }
+
+    struct ContestResult {
+        int solved;
+        int penalty;
+        vector<int> solve_times;
+
+        ContestResult() : solved(0), penalty(0) {}
+    };
+
+    vector<SeasonTeam> teams;
+    unordered_map<string, int> ids;
+    RankingIndex<SeasonLess> index;
+
+    int team_id(const string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        int id = teams.size();
+        ids[name] = id;
+        teams.push_back(SeasonTeam());
+        teams.back().name = name;
+        index.resize(teams.size());
+        return id;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    bool by_points = false;
+    vector<const char*> files;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--points") == 0) {
+            by_points = true;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        cerr << "usage: " << argv[0] << " [--points] FILE...\n";
+        return 1;
+    }
+
+    SeasonLeaderboard season(by_points);
+    for (const char* file : files) {
+        SubmissionColumns contest;
+        if (!read_submission_log(file, contest)) {
+            cerr << "cannot read submission log " << file << "\n";
+            return 1;
+        }
+        season.add_contest(contest);
+    }
+    cout << "rank team contests points solved penalty\n";
+    season.print(cout);
+    return 0;
+}
@@ -0,0 +1,297 @@
+#include "submission_log.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+const char* const STATUS_NAMES[STATUS_COUNT] = {
+    "Accepted", "Wrong_Answer", "Runtime_Error", "Time_Limit_Exceed"
+};
+
+int parse_status(const string& name) {
+    for (int i = 0; i < STATUS_COUNT; i++) {
+        if (name == STATUS_NAMES[i]) return i;
+    }
+    return STATUS_COUNT;
+}
+
+namespace {
+
+const char MAGIC[8] = {'I', 'C', 'P', 'C', 'S', 'U', 'B', '1'};
+const uint32_t FORMAT_VERSION = 2;
+const uint32_t MAX_PROBLEMS = 26; // 'A' to 'Z'
+const size_t WRITE_CHUNK = 1 << 20;
+
+uint32_t tag(const char* name) {
+    return (uint32_t)name[0] | (uint32_t)name[1] << 8 | (uint32_t)name[2] << 16 |
+           (uint32_t)name[3] << 24;
+}
+
+// Collects output into 1 MB chunks so the file is written with a few large
+// sequential writes.
+class ChunkWriter {
+public:
+    explicit ChunkWriter(FILE* file) : file(file), ok(true) {
+        buffer.reserve(WRITE_CHUNK);
+    }
+
+    void put(const void* data, size_t size) {
+        buffer.append((const char*)data, size);
+        if (buffer.size() >= WRITE_CHUNK) flush();
+    }
+
+    void put_u8(uint8_t v) { put(&v, 1); }
+
+    void put_u32(uint32_t v) {
+        uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+        put(b, 4);
+    }
+
+    void put_u64(uint64_t v) {
+        put_u32((uint32_t)v);
+        put_u32((uint32_t)(v >> 32));
+    }
+
+    void put_varint(uint32_t v) {
+        while (v >= 0x80) {
+            put_u8((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        put_u8((uint8_t)v);
+    }
+
+    bool finish() {
+        flush();
+        return ok;
+    }
+
+private:
+    FILE* file;
+    string buffer;
+    bool ok;
+
+    void flush() {
+        if (!buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+            ok = false;
+        }
+        buffer.clear();
+    }
+};
+
+size_t varint_size(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+class Reader {
+public:
+    Reader(const string& data) : data(data), pos(0), ok(true) {}
+
+    bool need(size_t n) {
+        if (data.size() - pos < n) ok = false;
+        return ok;
+    }
+
+    uint8_t u8() {
+        return need(1) ? (uint8_t)data[pos++] : 0;
+    }
+
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        const unsigned char* p = (const unsigned char*)data.data() + pos;
+        pos += 4;
+        return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    uint64_t u64() {
+        uint64_t low = u32();
+        return low | (uint64_t)u32() << 32;
+    }
+
+    const string& data;
+    size_t pos;
+    bool ok;
+};
+
+}  // namespace
+
+bool write_submission_log(const string& path, const vector<string>& team_names,
+                          int problem_count, const Submission* log, size_t count,
+                          const vector<FinalStanding>& standings) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    ChunkWriter out(file);
+    out.put(MAGIC, sizeof(MAGIC));
+    out.put_u32(FORMAT_VERSION);
+    out.put_u32(team_names.size());
+    out.put_u32(problem_count);
+    out.put_u64(count);
+    for (auto& name : team_names) {
+        out.put_u8(name.size());
+        out.put(name.data(), name.size());
+    }
+
+    out.put_u32(tag("TEAM"));
+    out.put_u64(4 * count);
+    for (const Submission* sub = log; sub != log + count; sub++) out.put_u32(sub->team);
+
+    out.put_u32(tag("PROB"));
+    out.put_u64(count);
+    for (const Submission* sub = log; sub != log + count; sub++) out.put_u8(sub->problem);
+
+    out.put_u32(tag("STAT"));
+    out.put_u64(count);
+    for (const Submission* sub = log; sub != log + count; sub++) out.put_u8(sub->status);
+
+    uint64_t time_bytes = 0;
+    int last = 0;
+    for (const Submission* sub = log; sub != log + count; sub++) {
+        time_bytes += varint_size(sub->time - last);
+        last = sub->time;
+    }
+    out.put_u32(tag("TIME"));
+    out.put_u64(time_bytes);
+    last = 0;
+    for (const Submission* sub = log; sub != log + count; sub++) {
+        out.put_varint(sub->time - last);
+        last = sub->time;
+    }
+
+    out.put_u32(tag("FRZN"));
+    out.put_u64((count + 7) / 8);
+    for (size_t i = 0; i < count; i += 8) {
+        uint8_t bits = 0;
+        for (size_t j = i; j < i + 8 && j < count; j++) {
+            if (!log[j].before_freeze) bits |= 1 << (j - i);
+        }
+        out.put_u8(bits);
+    }
+
+    out.put_u32(tag("STND"));
+    out.put_u64(12 * standings.size());
+    for (const FinalStanding& standing : standings) {
+        out.put_u32(standing.rank);
+        out.put_u32(standing.solved);
+        out.put_u32(standing.penalty);
+    }
+
+    bool ok = out.finish();
+    return fclose(file) == 0 && ok;
+}
+
+bool read_submission_log(const string& path, SubmissionColumns& columns) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    string data;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    size_t got = fread(&data[0], 1, data.size(), file);
+    fclose(file);
+    if (got != data.size() || data.size() < sizeof(MAGIC) ||
+        memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+
+    Reader in(data);
+    in.pos = sizeof(MAGIC);
+    uint32_t version = in.u32();
+    if (version != 1 && version != FORMAT_VERSION) return false;
+    uint32_t team_count = in.u32();
+    uint32_t problem_count = in.u32();
+    uint64_t rows = in.u64();
+    // Every name and every row takes at least a byte, so neither count can
+    // exceed the file size; nothing is allocated from them before that.
+    if (!in.ok || problem_count > MAX_PROBLEMS || team_count > data.size() - in.pos ||
+        rows > data.size() - in.pos) {
+        return false;
+    }
+    columns.problem_count = problem_count;
+
+    columns.team_names.resize(team_count);
+    for (auto& name : columns.team_names) {
+        uint8_t len = in.u8();
+        if (!in.need(len)) return false;
+        name.assign(data, in.pos, len);
+        in.pos += len;
+    }
+
+    // Locate and size-check every block before decoding any of them
+    const char* names[] = {"TEAM", "PROB", "STAT", "TIME", "FRZN", "STND"};
+    uint64_t expected[] = {4 * rows, rows, rows, 0, (rows + 7) / 8, 12 * (uint64_t)team_count};
+    size_t blocks = version >= 2 ? 6 : 5;
+    size_t offsets[6], sizes[6];
+    for (size_t b = 0; b < blocks; b++) {
+        uint32_t column = in.u32();
+        uint64_t bytes = in.u64();
+        if (!in.ok || column != tag(names[b]) || !in.need(bytes)) return false;
+        // Time deltas are varints of at least a byte each
+        if (b == 3 ? bytes < rows : bytes != expected[b]) return false;
+        offsets[b] = in.pos;
+        sizes[b] = bytes;
+        in.pos += bytes;
+    }
+
+    columns.team.resize(rows);
+    columns.problem.resize(rows);
+    columns.status.resize(rows);
+    columns.time.resize(rows);
+    columns.frozen.resize(rows);
+
+    const unsigned char* base = (const unsigned char*)data.data();
+    const unsigned char* p = base + offsets[0];
+    for (uint64_t i = 0; i < rows; i++, p += 4) {
+        columns.team[i] = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+        if (columns.team[i] >= team_count) return false;
+    }
+
+    memcpy(columns.problem.data(), base + offsets[1], rows);
+    memcpy(columns.status.data(), base + offsets[2], rows);
+    for (uint64_t i = 0; i < rows; i++) {
+        if (columns.problem[i] >= problem_count || columns.status[i] >= STATUS_COUNT) return false;
+    }
+
+    p = base + offsets[3];
+    const unsigned char* end = p + sizes[3];
+    int64_t time = 0;
+    for (uint64_t i = 0; i < rows; i++) {
+        uint32_t delta = 0;
+        int shift = 0;
+        while (p < end && (*p & 0x80) && shift < 28) {
+            delta |= (uint32_t)(*p++ & 0x7f) << shift;
+            shift += 7;
+        }
+        // A fifth byte only has four bits left
+        if (p == end || (shift == 28 && *p > 0x0f)) return false;
+        delta |= (uint32_t)*p++ << shift;
+        time += delta;
+        if (time > INT32_MAX) return false;
+        columns.time[i] = time;
+    }
+
+    p = base + offsets[4];
+    for (uint64_t i = 0; i < rows; i++) {
+        columns.frozen[i] = p[i / 8] >> (i % 8) & 1;
+    }
+
+    columns.standings.clear();
+    if (version >= 2) {
+        columns.standings.resize(team_count);
+        p = base + offsets[5];
+        for (FinalStanding& standing : columns.standings) {
+            standing.rank = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+            standing.solved = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24;
+            standing.penalty = p[8] | p[9] << 8 | p[10] << 16 | (uint32_t)p[11] << 24;
+            p += 12;
+            if (standing.rank > team_count || standing.solved > problem_count) return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef SUBMISSION_LOG_H
+#define SUBMISSION_LOG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum SubmitStatus {
+    ACCEPTED,
+    WRONG_ANSWER,
+    RUNTIME_ERROR,
+    TIME_LIMIT_EXCEED,
+    STATUS_COUNT
+};
+
+extern const char* const STATUS_NAMES[STATUS_COUNT];
+
+// Returns STATUS_COUNT for an unknown name.
+int parse_status(const std::string& name);
+
+// One entry of the engine's submission store, in arrival order.
+struct Submission {
+    int team;               // team id
+    int time;
+    unsigned char problem;  // 0 = 'A'
+    unsigned char status;   // SubmitStatus
+    bool before_freeze;
+};
+
+// A team's place in the engine's final standings at END.
+struct FinalStanding {
+    uint32_t rank;    // 0 for a hidden or disqualified team
+    uint32_t solved;
+    int32_t penalty;  // jury adjustments included
+};
+
+// Columnar export of the submission store. All integers are little-endian.
+//
+//   header   "ICPCSUB1"  u32 format version (2; version 1 has no STND block)
+//            u32 team_count  u32 problem_count  u64 row_count
+//   names    team_count x (u8 length, bytes); entry i is the name of team id i
+//   columns  five blocks in this order, each "u32 tag, u64 payload bytes, payload":
+//     TEAM   u32 team id per row
+//     PROB   u8 problem index per row (0 = 'A')
+//     STAT   u8 SubmitStatus per row
+//     TIME   LEB128 varint per row: time minus the previous row's time (the
+//            first row is relative to 0; times never decrease)
+//     FRZN   bitmap, bit (i % 8) of byte (i / 8) set if row i was submitted
+//            while the scoreboard was frozen
+//   standings  one more block, "STND": team_count x (u32 rank, u32 solved,
+//            i32 penalty), the FinalStanding of team id i
+//
+// Rows are in submission order. Every block is written with large sequential
+// writes, so a reader can also skip straight to the columns it needs.
+struct SubmissionColumns {
+    std::vector<std::string> team_names;
+    int problem_count;
+    std::vector<uint32_t> team;
+    std::vector<uint8_t> problem;
+    std::vector<uint8_t> status;
+    std::vector<int32_t> time;
+    std::vector<uint8_t> frozen;  // one byte per row, 0 or 1
+    std::vector<FinalStanding> standings;  // by team id; empty for version 1
+
+    SubmissionColumns() : problem_count(0) {}
+};
+
+// standings has one entry per team name.
+bool write_submission_log(const std::string& path, const std::vector<std::string>& team_names,
+                          int problem_count, const Submission* log, size_t count,
+                          const std::vector<FinalStanding>& standings);
+
+// False unless path holds a well-formed log. Block sizes are checked before
+// anything is allocated, and team ids, problems and statuses are range
+// checked, so callers may index by them.
+bool read_submission_log(const std::string& path, SubmissionColumns& columns);
+
+#endif
@@ -0,0 +1,59 @@
+// Reads a submission log written by `code --export FILE`, prints a short
+// summary and the scan throughput of the columnar format.
+//
+//   submission_reader FILE [ROUNDS]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "submission_log.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " FILE [ROUNDS]\n";
+        return 1;
+    }
+    int rounds = argc > 2 ? max(1, atoi(argv[2])) : 5;
+
+    SubmissionColumns columns;
+    double best = 0;
+    for (int r = 0; r < rounds; r++) {
+        auto begin = chrono::steady_clock::now();
+        if (!read_submission_log(argv[1], columns)) {
+            cerr << "cannot read submission log " << argv[1] << "\n";
+            return 1;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        if (r == 0 || seconds < best) best = seconds;
+    }
+
+    // A full scan over the decoded columns, the typical analytics access.
+    auto begin = chrono::steady_clock::now();
+    size_t rows = columns.time.size();
+    vector<long long> by_status(STATUS_COUNT);
+    vector<long long> accepted_by_problem(columns.problem_count);
+    long long frozen = 0;
+    for (size_t i = 0; i < rows; i++) {
+        by_status[columns.status[i]]++;
+        if (columns.status[i] == ACCEPTED) accepted_by_problem[columns.problem[i]]++;
+        frozen += columns.frozen[i];
+    }
+    double scan = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    cout << "teams " << columns.team_names.size() << " problems " << columns.problem_count
+         << " submissions " << rows << " frozen " << frozen << "\n";
+    for (int s = 0; s < STATUS_COUNT; s++) {
+        cout << STATUS_NAMES[s] << " " << by_status[s] << "\n";
+    }
+    for (int p = 0; p < columns.problem_count; p++) {
+        cout << char('A' + p) << " accepted " << accepted_by_problem[p] << "\n";
+    }
+    cout << "load+decode " << best * 1e3 << " ms (" << (best > 0 ? rows / best / 1e6 : 0)
+         << " M rows/s), scan " << scan * 1e3 << " ms ("
+         << (scan > 0 ? rows / scan / 1e6 : 0) << " M rows/s)\n";
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "submission_store.h"
+
+using namespace std;
+
+const int SubmissionStore::BLOCK_ENTRIES;
+const size_t SubmissionStore::RECENT_WINDOW;
+
+void SubmissionStore::add_teams(int teams) {
+    if ((int)logs.size() < teams) logs.resize(teams);
+}
+
+void SubmissionStore::reserve(size_t submissions) {
+    // About three bytes per entry once sealed
+    bytes.reserve(submissions * 3);
+}
+
+size_t SubmissionStore::append(const Submission& sub) {
+    size_t index = count++;
+    if (times.empty() || times.back().time != sub.time) {
+        times.push_back(TimeRun{sub.time, (uint32_t)index});
+    }
+    TeamLog& log = logs[sub.team];
+    if (log.open.count == BLOCK_ENTRIES) seal(log);
+    add_to_open(log, index, pack(sub));
+
+    if (recent.empty()) recent.resize(RECENT_WINDOW);
+    recent[index % RECENT_WINDOW] = sub;
+    recent_count = min(recent_count + 1, RECENT_WINDOW);
+    return index;
+}
+
+void SubmissionStore::pop_back(int team) {
+    TeamLog& log = logs[team];
+    if (log.open.count == 0) {
+        // Reopen the newest sealed block. Its bytes stay in the arena unless
+        // they are at the end of it.
+        Block block = log.blocks.back();
+        log.blocks.pop_back();
+        const uint8_t* begin = bytes.data() + block.offset;
+        const uint8_t* end = begin;
+        for (int i = 0; i < block.count; i++) {
+            end++; // code
+            while (*end++ & 0x80) {
+            }
+        }
+        log.open_bytes.assign(begin, end);
+        if (end == bytes.data() + bytes.size()) bytes.resize(block.offset);
+        log.open = block;
+    }
+
+    // Rebuild the open block without its newest entry
+    uint32_t indices[BLOCK_ENTRIES];
+    uint8_t codes[BLOCK_ENTRIES];
+    int n = 0;
+    decode(log.open_bytes.data(), log.open, [&](uint32_t index, uint8_t code) {
+        indices[n] = index;
+        codes[n++] = code;
+        return true;
+    });
+    log.open = Block();
+    log.open_bytes.clear();
+    for (int i = 0; i + 1 < n; i++) {
+        add_to_open(log, indices[i], codes[i]);
+    }
+
+    count--;
+    if (times.back().first == count) times.pop_back();
+    if (recent_count > 0) recent_count--;
+}
+
+size_t SubmissionStore::first_at_or_after(int time) const {
+    auto it = lower_bound(times.begin(), times.end(), time,
+                          [](const TimeRun& run, int t) { return run.time < t; });
+    return it == times.end() ? count : it->first;
+}
+
+size_t SubmissionStore::first_after(int time) const {
+    auto it = upper_bound(times.begin(), times.end(), time,
+                          [](int t, const TimeRun& run) { return t < run.time; });
+    return it == times.end() ? count : it->first;
+}
+
+bool SubmissionStore::find_last(int team, int problem, int status, Submission& found) const {
+    const TeamLog& log = logs[team];
+    for (size_t b = log.blocks.size() + 1; b-- > 0;) {
+        const Block& block = block_at(log, b);
+        if (!block_matches(block, problem, status)) continue;
+        // Entries only decode forward; keep the last match of the block
+        uint32_t last_index = 0;
+        int last_code = -1;
+        decode(block_data(log, b), block, [&](uint32_t index, uint8_t code) {
+            if (code_matches(code, problem, status)) {
+                last_index = index;
+                last_code = code;
+            }
+            return true;
+        });
+        if (last_code >= 0) {
+            found = unpack(team, last_index, last_code);
+            return true;
+        }
+    }
+    return false;
+}
+
+MemoryUsage SubmissionStore::memory() const {
+    MemoryUsage usage = vector_usage(bytes);
+    usage += vector_usage(logs);
+    for (const TeamLog& log : logs) {
+        usage += vector_usage(log.blocks);
+        usage += vector_usage(log.open_bytes);
+    }
+    usage += vector_usage(times);
+    // The ring is allocated whole; only its valid tail is live
+    usage += MemoryUsage(recent_count * sizeof(Submission), recent.capacity() * sizeof(Submission));
+    return usage;
+}
+
+int SubmissionStore::time_of(size_t index) const {
+    auto it = upper_bound(times.begin(), times.end(), index,
+                          [](size_t i, const TimeRun& run) { return i < run.first; });
+    return prev(it)->time;
+}
+
+void SubmissionStore::add_to_open(TeamLog& log, uint32_t index, uint8_t code) {
+    Block& open = log.open;
+    if (open.count == 0) {
+        open.first = log.last = index;
+    }
+    log.open_bytes.push_back(code);
+    for (uint32_t gap = index - log.last;; gap >>= 7) {
+        if (gap < 0x80) {
+            log.open_bytes.push_back(gap);
+            break;
+        }
+        log.open_bytes.push_back((gap & 0x7f) | 0x80);
+    }
+    log.last = index;
+    open.problems |= 1u << (code & 0x1f);
+    open.statuses |= 1 << (code >> 5 & 3);
+    open.count++;
+}
+
+void SubmissionStore::seal(TeamLog& log) {
+    log.open.offset = bytes.size();
+    bytes.insert(bytes.end(), log.open_bytes.begin(), log.open_bytes.end());
+    log.blocks.push_back(log.open);
+    log.open = Block();
+    log.open_bytes.clear();
+}
+
+void SubmissionStore::decode_from(size_t first, vector<Submission>& rows) const {
+    rows.assign(count - first, Submission());
+    for (size_t team = 0; team < logs.size(); team++) {
+        const TeamLog& log = logs[team];
+        // Newest block first, down to the one that starts at or before first
+        for (size_t b = log.blocks.size() + 1; b-- > 0;) {
+            const Block& block = block_at(log, b);
+            decode(block_data(log, b), block, [&](uint32_t index, uint8_t code) {
+                if (index >= first) {
+                    Submission& row = rows[index - first];
+                    row.team = team;
+                    row.problem = code & 0x1f;
+                    row.status = code >> 5 & 3;
+                    row.before_freeze = !(code & 0x80);
+                }
+                return true;
+            });
+            if (block.count > 0 && block.first <= first) break;
+        }
+    }
+    // Times run by run, from the run holding first
+    size_t r = upper_bound(times.begin(), times.end(), first,
+                           [](size_t i, const TimeRun& run) { return i < run.first; }) -
+               times.begin();
+    for (r = r > 0 ? r - 1 : 0; r < times.size(); r++) {
+        size_t begin = max<size_t>(times[r].first, first);
+        size_t end = r + 1 < times.size() ? times[r + 1].first : count;
+        for (size_t i = begin; i < end; i++) {
+            rows[i - first].time = times[r].time;
+        }
+    }
+}
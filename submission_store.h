@@ -0,0 +1,196 @@
+#ifndef SUBMISSION_STORE_H
+#define SUBMISSION_STORE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "huge_pages.h"
+#include "memory_stats.h"
+#include "submission_log.h"
+
+// The engine's in-memory submission log, compressed to a few bytes per
+// submission.
+//
+// Submissions are numbered by arrival. Each team keeps its own submissions in
+// blocks of up to BLOCK_ENTRIES. An entry is one byte packing problem, status
+// and the frozen flag, then a LEB128 varint of the gap to the team's previous
+// arrival index in the block. Sealed blocks are appended to one shared byte
+// arena; the open block of every team grows in a small buffer of its own.
+// Each block header is a skip index: its first arrival index, which problems
+// and which statuses occur in it. Queries by problem or status only decode
+// blocks that can match.
+//
+// Times are not stored per entry. They never decrease, so one (time, first
+// arrival index) run per distinct time maps an arrival index to its time.
+// The latest RECENT_WINDOW submissions are also kept whole in a ring for
+// QUERY_RECENT.
+class SubmissionStore {
+public:
+    static const int BLOCK_ENTRIES = 64;
+    static const size_t RECENT_WINDOW = 1 << 12;
+
+    SubmissionStore() : count(0), recent_count(0) {}
+
+    // Makes room for team ids 0..teams-1; never shrinks.
+    void add_teams(int teams);
+    void reserve(size_t submissions);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Returns the arrival index. Times must not decrease.
+    size_t append(const Submission& sub);
+    // Removes the newest submission, which must be one of team's.
+    void pop_back(int team);
+
+    // Arrival index range of the times [from_time, to_time].
+    size_t first_at_or_after(int time) const;
+    size_t first_after(int time) const;
+
+    // Calls visit(index, sub) for the submissions of team with arrival index
+    // in [from, to) matching problem and status (-1 matches any), oldest
+    // first, until visit returns false.
+    template <class Visit>
+    void scan(int team, int problem, int status, size_t from, size_t to, Visit visit) const {
+        const TeamLog& log = logs[team];
+        // The last block starting at or before from may still hold it
+        size_t b = std::upper_bound(log.blocks.begin(), log.blocks.end(), from,
+                                    [](size_t index, const Block& block) {
+                                        return index < block.first;
+                                    }) -
+                   log.blocks.begin();
+        if (b > 0) b--;
+        for (; b <= log.blocks.size(); b++) {
+            const Block& block = block_at(log, b);
+            if (block.count == 0 || block.first >= to) break;
+            if (!block_matches(block, problem, status)) continue;
+            bool more = decode(block_data(log, b), block, [&](uint32_t index, uint8_t code) {
+                if (index < from) return true;
+                if (index >= to) return false;
+                if (!code_matches(code, problem, status)) return true;
+                return visit(index, unpack(team, index, code));
+            });
+            if (!more) break;
+        }
+    }
+
+    template <class Visit>
+    void scan(int team, int problem, int status, Visit visit) const {
+        scan(team, problem, status, 0, count, visit);
+    }
+
+    // Newest submission of team matching problem and status; false if none.
+    bool find_last(int team, int problem, int status, Submission& found) const;
+
+    // The latest k submissions, newest first, as visit(index, sub).
+    template <class Visit>
+    void for_each_recent(size_t k, Visit visit) const {
+        k = std::min(k, count);
+        if (k <= recent_count) {
+            for (size_t i = count; i-- > count - k;) {
+                visit(i, recent[i % RECENT_WINDOW]);
+            }
+            return;
+        }
+        std::vector<Submission> rows;
+        decode_from(count - k, rows);
+        for (size_t i = rows.size(); i-- > 0;) {
+            visit(count - k + i, rows[i]);
+        }
+    }
+
+    // Every submission in arrival order.
+    void decode_all(std::vector<Submission>& rows) const { decode_from(0, rows); }
+
+    MemoryUsage memory() const;
+
+private:
+    struct Block {
+        uint32_t offset;   // start in bytes; unused while the block is open
+        uint32_t first;    // arrival index of the first entry
+        uint32_t problems; // bit p set if an entry is for problem p
+        uint8_t statuses;  // bit s set if an entry has status s
+        uint8_t count;
+
+        Block() : offset(0), first(0), problems(0), statuses(0), count(0) {}
+    };
+
+    struct TeamLog {
+        std::vector<Block> blocks; // sealed, oldest first
+        Block open;
+        std::vector<uint8_t> open_bytes;
+        uint32_t last; // arrival index of the open block's newest entry
+
+        TeamLog() : last(0) {}
+    };
+
+    struct TimeRun {
+        int time;
+        uint32_t first; // arrival index of the first submission at time
+    };
+
+    HugeVector<uint8_t> bytes; // sealed blocks of every team
+    std::vector<TeamLog> logs; // by team id
+    std::vector<TimeRun> times;
+    size_t count;
+    std::vector<Submission> recent; // ring; index i is at i % RECENT_WINDOW
+    size_t recent_count;            // valid entries at the tail of the ring
+
+    static uint8_t pack(const Submission& sub) {
+        return sub.problem | sub.status << 5 | (sub.before_freeze ? 0 : 0x80);
+    }
+
+    Submission unpack(int team, uint32_t index, uint8_t code) const {
+        Submission sub;
+        sub.team = team;
+        sub.time = time_of(index);
+        sub.problem = code & 0x1f;
+        sub.status = code >> 5 & 3;
+        sub.before_freeze = !(code & 0x80);
+        return sub;
+    }
+
+    static bool block_matches(const Block& block, int problem, int status) {
+        return (problem < 0 || (block.problems >> problem & 1)) &&
+               (status < 0 || (block.statuses >> status & 1));
+    }
+
+    static bool code_matches(uint8_t code, int problem, int status) {
+        return (problem < 0 || (code & 0x1f) == problem) && (status < 0 || (code >> 5 & 3) == status);
+    }
+
+    // Block b of a team; b == blocks.size() is the open block.
+    const Block& block_at(const TeamLog& log, size_t b) const {
+        return b < log.blocks.size() ? log.blocks[b] : log.open;
+    }
+
+    const uint8_t* block_data(const TeamLog& log, size_t b) const {
+        return b < log.blocks.size() ? bytes.data() + log.blocks[b].offset : log.open_bytes.data();
+    }
+
+    // Calls visit(index, code) for every entry, until it returns false.
+    template <class Visit>
+    static bool decode(const uint8_t* p, const Block& block, Visit visit) {
+        uint32_t index = block.first;
+        for (int i = 0; i < block.count; i++) {
+            uint8_t code = *p++;
+            uint32_t gap = 0;
+            for (int shift = 0;; shift += 7) {
+                uint8_t byte = *p++;
+                gap |= uint32_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) break;
+            }
+            index += gap;
+            if (!visit(index, code)) return false;
+        }
+        return true;
+    }
+
+    int time_of(size_t index) const;
+    void add_to_open(TeamLog& log, uint32_t index, uint8_t code);
+    void seal(TeamLog& log);
+    void decode_from(size_t first, std::vector<Submission>& rows) const;
+};
+
+#endif
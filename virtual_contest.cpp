@@ -0,0 +1,256 @@
+// Virtual participation in an archived contest: virtual teams submit on the
+// original timeline and are ranked against the original field as it stood
+// at each moment. The archive is a submission log written by
+// `code --export FILE`.
+//
+//   virtual_contest FILE < commands
+//
+//   SUBMIT [problem] BY [team] WITH [status] AT [time]
+//   QUERY_RANKING [team] AT [time]
+//   END
+//
+// Standings compare solved count, then penalty, then the solve times from the
+// latest down, as the engine does; a virtual team ties ahead of original
+// teams with the same standing. A virtual team's submissions are expected in
+// time order, like the original log.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "submission_log.h"
+
+using namespace std;
+
+namespace {
+
+const int MAX_TIME = 1 << 20;
+// Sorted key arrays kept in memory across all checkpoints.
+const size_t CHECKPOINT_BUDGET = 1 << 22;
+
+// Solve-time lists of every standing, latest solve first. A team's new solve
+// is never earlier than its previous ones, so each list is the new time in
+// front of the team's previous list, which it shares.
+class SolveTimes {
+public:
+    static const int EMPTY = -1;
+
+    int push(int time, int rest) {
+        nodes.push_back(Node{time, rest});
+        return nodes.size() - 1;
+    }
+
+    // Whether list a ranks above list b of the same length: the first
+    // differing time is smaller.
+    bool earlier(int a, int b) const {
+        for (; a != b; a = nodes[a].rest, b = nodes[b].rest) {
+            if (nodes[a].time != nodes[b].time) return nodes[a].time < nodes[b].time;
+        }
+        return false;
+    }
+
+private:
+    struct Node {
+        int time;
+        int rest;
+    };
+
+    vector<Node> nodes;
+};
+
+struct Standing {
+    int solved;
+    int penalty;
+    int last_solve;
+    int solve_times; // list in SolveTimes
+
+    Standing() : solved(0), penalty(0), last_solve(0), solve_times(SolveTimes::EMPTY) {}
+
+    void solve(SolveTimes& lists, int time, int penalty_minutes) {
+        solved++;
+        penalty += penalty_minutes;
+        last_solve = time;
+        solve_times = lists.push(time, solve_times);
+    }
+
+    // Larger is better; solved < 2^5, penalty < 2^26, times < 2^20. Equal
+    // keys still differ in the earlier solve times.
+    uint64_t key() const {
+        return (uint64_t)solved << 46 | (uint64_t)((1 << 26) - 1 - penalty) << 20 |
+               (uint64_t)(MAX_TIME - 1 - last_solve);
+    }
+};
+
+// A standing as stored in the timeline: its key and its solve-time list.
+struct RankedKey {
+    uint64_t key;
+    int solve_times;
+};
+
+// "a ranks below b", the order checkpoints are sorted in.
+struct RanksBelow {
+    const SolveTimes* lists;
+
+    bool operator()(const RankedKey& a, const RankedKey& b) const {
+        if (a.key != b.key) return a.key < b.key;
+        return lists->earlier(b.solve_times, a.solve_times);
+    }
+};
+
+}  // namespace
+
+// Standings of the original field over time. Every accepted submission is
+// an event replacing one team's key; every few events a sorted copy of all
+// keys is kept. The rank of a key at time t is a binary search in the last
+// checkpoint before t plus a correction for the events since then.
+class ContestTimeline {
+public:
+    ContestTimeline(const SubmissionColumns& contest, SolveTimes& lists) : below(RanksBelow{&lists}) {
+        size_t n = contest.team_names.size();
+        vector<Standing> teams(n);
+        vector<RankedKey> keys(n, RankedKey{Standing().key(), SolveTimes::EMPTY});
+        vector<int> wrong(n * contest.problem_count, 0);
+        vector<bool> solved(n * contest.problem_count, false);
+
+        size_t accepted = 0;
+        for (uint8_t status : contest.status) {
+            accepted += status == ACCEPTED;
+        }
+        size_t checkpoints = max<size_t>(1, CHECKPOINT_BUDGET / max<size_t>(n, 1));
+        stride = max<size_t>(1, accepted / checkpoints + 1);
+        add_checkpoint(keys);
+
+        for (size_t i = 0; i < contest.time.size(); i++) {
+            size_t team = contest.team[i];
+            size_t cell = team * contest.problem_count + contest.problem[i];
+            if (solved[cell]) continue;
+            if (contest.status[i] != ACCEPTED) {
+                wrong[cell]++;
+                continue;
+            }
+            solved[cell] = true;
+            Standing& standing = teams[team];
+            standing.solve(lists, contest.time[i], contest.time[i] + 20 * wrong[cell]);
+
+            Event event;
+            event.time = contest.time[i];
+            event.old_key = keys[team];
+            event.new_key = keys[team] = RankedKey{standing.key(), standing.solve_times};
+            events.push_back(event);
+            if (events.size() % stride == 0) {
+                add_checkpoint(keys);
+            }
+        }
+    }
+
+    // 1 + the number of original teams strictly ahead of standing at time t.
+    int rank(const Standing& standing, int time) const {
+        RankedKey key{standing.key(), standing.solve_times};
+        size_t applied = upper_bound(events.begin(), events.end(), time,
+                                     [](int t, const Event& e) { return t < e.time; }) - events.begin();
+        const Checkpoint& cp = checkpoints[applied / stride];
+        int ahead = cp.keys.end() - upper_bound(cp.keys.begin(), cp.keys.end(), key, below);
+        for (size_t e = cp.events; e < applied; e++) {
+            ahead += below(key, events[e].new_key) - below(key, events[e].old_key);
+        }
+        return ahead + 1;
+    }
+
+private:
+    struct Event {
+        int time;
+        RankedKey old_key;
+        RankedKey new_key;
+    };
+
+    struct Checkpoint {
+        size_t events; // events already applied to keys
+        vector<RankedKey> keys;
+    };
+
+    RanksBelow below;
+    vector<Event> events;
+    vector<Checkpoint> checkpoints; // checkpoint k covers the first k * stride events
+    size_t stride;
+
+    void add_checkpoint(const vector<RankedKey>& keys) {
+        Checkpoint cp;
+        cp.events = events.size();
+        cp.keys = keys;
+        sort(cp.keys.begin(), cp.keys.end(), below);
+        checkpoints.push_back(move(cp));
+    }
+};
+
+struct VirtualTeam {
+    Standing standing;
+    // (time, standing) after each of the team's solves, in time order.
+    vector<pair<int, Standing>> history;
+    int wrong[26];
+    bool solved[26];
+
+    VirtualTeam() {
+        fill(wrong, wrong + 26, 0);
+        fill(solved, solved + 26, false);
+    }
+
+    Standing at(int time) const {
+        auto it = upper_bound(history.begin(), history.end(), time,
+                              [](int t, const pair<int, Standing>& h) { return t < h.first; });
+        return it == history.begin() ? Standing() : prev(it)->second;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    ios_base::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " FILE\n";
+        return 1;
+    }
+    SubmissionColumns contest;
+    if (!read_submission_log(argv[1], contest)) {
+        cerr << "cannot read submission log " << argv[1] << "\n";
+        return 1;
+    }
+    SolveTimes lists;
+    ContestTimeline timeline(contest, lists);
+    map<string, VirtualTeam> teams;
+
+    string line;
+    while (getline(cin, line)) {
+        istringstream iss(line);
+        string command;
+        iss >> command;
+        if (command == "SUBMIT") {
+            string problem, by, team_name, with, status, at;
+            int time;
+            iss >> problem >> by >> team_name >> with >> status >> at >> time;
+            VirtualTeam& team = teams[team_name];
+            int p = problem[0] - 'A';
+            if (team.solved[p]) continue;
+            if (parse_status(status) != ACCEPTED) {
+                team.wrong[p]++;
+                continue;
+            }
+            team.solved[p] = true;
+            team.standing.solve(lists, time, time + 20 * team.wrong[p]);
+            team.history.push_back(make_pair(time, team.standing));
+        } else if (command == "QUERY_RANKING") {
+            string team_name, at;
+            int time;
+            iss >> team_name >> at >> time;
+            Standing standing = teams.count(team_name) ? teams[team_name].at(time) : Standing();
+            cout << team_name << " AT " << time << " RANKING " << timeline.rank(standing, time)
+                 << "\n";
+        } else if (command == "END") {
+            break;
+        }
+    }
+    return 0;
+}